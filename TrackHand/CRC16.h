@@ -0,0 +1,56 @@
+/// Copyright 2014 Henry G. Weller
+// -----------------------------------------------------------------------------
+//  This file is part of
+/// ---     TrackHand: DataHand with Laser TrackBall
+// -----------------------------------------------------------------------------
+//
+//  TrackHand is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  TrackHand is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+//  for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with TrackHand.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+/// Title: CRC-16
+///  Description:
+//    CRC-16/CCITT-FALSE, polynomial 0x1021 initialised to 0xffff, used to
+//    check the configuration block stored in EEPROM.
+// -----------------------------------------------------------------------------
+
+#ifndef CRC16_H
+#define CRC16_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// -----------------------------------------------------------------------------
+
+//- Return the CRC of the n bytes of data continuing from crc
+inline uint16_t crc16(const void* data, const size_t n, uint16_t crc = 0xffff)
+{
+    const uint8_t* d = static_cast<const uint8_t*>(data);
+
+    for (size_t i=0; i<n; i++)
+    {
+        crc ^= uint16_t(d[i]) << 8;
+
+        for (uint8_t b=0; b<8; b++)
+        {
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+
+    return crc;
+}
+
+
+// -----------------------------------------------------------------------------
+#endif // CRC16_H
+// -----------------------------------------------------------------------------
@@ -0,0 +1,118 @@
+/// Copyright 2014 Henry G. Weller
+// -----------------------------------------------------------------------------
+//  This file is part of
+/// ---     TrackHand: DataHand with Laser TrackBall
+// -----------------------------------------------------------------------------
+//
+//  TrackHand is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  TrackHand is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+//  for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with TrackHand.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+/// Title: Configuration frame format
+///  Description:
+//    Format of the frames of the configuration protocol carried over the USB
+//    serial interface, shared by the firmware and thconf.
+//
+//    Each frame is the start byte, the type, the length of the payload as a
+//    16-bit word, the payload and the CRC-16 of the type, length and payload.
+//    Each request is answered by a frame of the request type with the reply
+//    bit set, the payload of which starts with the result.  Text printed by
+//    a command precedes its reply and never contains the start byte.
+//
+//    Multi-byte fields are little-endian, as on both the host and Teensy.
+// -----------------------------------------------------------------------------
+
+#ifndef ConfigFrame_H
+#define ConfigFrame_H
+
+#include <stdint.h>
+
+// -----------------------------------------------------------------------------
+
+namespace ConfigFrame
+{
+    //- Byte starting each frame
+    const uint8_t start = 0xfe;
+
+    //- Size of the start byte, type and length preceding the payload
+    const uint8_t headerSize = 4;
+
+    //- Size of the CRC following the payload
+    const uint8_t crcSize = 2;
+
+    //- Maximum size of the payload
+    const uint16_t maxPayload = 256;
+
+    //- Bit set in the type of the reply
+    const uint8_t reply = 0x80;
+
+    //- Profile addressing the profile selected
+    const uint8_t selected = 0xff;
+
+    //- Frame types and their payloads
+    enum type
+    {
+        // Configuration command character followed by its value, if any
+        command = 1,
+
+        // Profile, offset and number of bytes to read from the ConfigStore,
+        // replied with the bytes
+        get,
+
+        // Profile and offset followed by the bytes to write to the
+        // ConfigStore
+        set,
+
+        // Replied with the schema version, number of profiles, profile
+        // selected, number of sections and the size of each
+        layout,
+
+        // Replied with storeStatus
+        status
+    };
+
+    //- Result starting each reply
+    enum result
+    {
+        ok,
+        badCrc,
+        badType,
+        badArgs,
+        unknownCommand,
+        failed
+    };
+
+    //- State of the ConfigStore replied to a status request
+    struct storeStatus
+    {
+        // Status of the block found at startup:
+        // 0: blank, 1: corrupt, 2: other version, 3: valid
+        uint8_t stored;
+        uint8_t migrated;
+        uint8_t version;
+        uint8_t nProfiles;
+        uint8_t profile;
+        uint8_t pending;
+        uint16_t length;
+
+        // Writes of the block, and commits and bytes written since startup
+        uint32_t writes;
+        uint32_t commits;
+        uint32_t bytesWritten;
+    };
+}
+
+
+// -----------------------------------------------------------------------------
+#endif // ConfigFrame_H
+// -----------------------------------------------------------------------------
@@ -0,0 +1,270 @@
+/// Copyright 2014 Henry G. Weller
+// -----------------------------------------------------------------------------
+//  This file is part of
+/// ---     TrackHand: DataHand with Laser TrackBall
+// -----------------------------------------------------------------------------
+//
+//  TrackHand is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  TrackHand is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+//  for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with TrackHand.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+
+#include "ConfigProtocol.h"
+#include "ConfigStore.h"
+#include "CRC16.h"
+
+using namespace ConfigFrame;
+
+// -----------------------------------------------------------------------------
+
+// Time after the last byte at which an incomplete frame is discarded [ms]
+static const uint32_t frameTimeout = 100;
+
+// Function dispatching the command frames
+static bool (*command_)(const char cmd) = NULL;
+
+// Frame being received and the number of bytes received
+static uint8_t rx_[headerSize + maxPayload + crcSize];
+static uint16_t nRx_ = 0;
+static uint32_t lastRx_ = 0;
+
+// Position of the next value byte of the command frame being handled
+// and whether it has failed
+static uint16_t pos_ = 0;
+static bool failed_ = false;
+
+
+// Return the little-endian word at p
+static uint16_t word(const uint8_t* p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+
+// Return the length of the payload of the frame being received
+static uint16_t length()
+{
+    return word(rx_ + 2);
+}
+
+
+// Send the reply to the frame of the type with the result followed by
+// n bytes of data
+static void sendReply
+(
+    const uint8_t type,
+    const uint8_t res,
+    const void* data = NULL,
+    const uint16_t n = 0
+)
+{
+    const uint16_t len = 1 + n;
+    const uint8_t header[headerSize + 1] =
+    {
+        start,
+        uint8_t(type | ConfigFrame::reply),
+        uint8_t(len),
+        uint8_t(len >> 8),
+        res
+    };
+
+    uint16_t crc = crc16(header + 1, sizeof(header) - 1);
+    crc = crc16(data, n, crc);
+    const uint8_t trailer[crcSize] = {uint8_t(crc), uint8_t(crc >> 8)};
+
+    Serial.write(header, sizeof(header));
+
+    if (n)
+    {
+        Serial.write(static_cast<const uint8_t*>(data), n);
+    }
+
+    Serial.write(trailer, sizeof(trailer));
+    Serial.send_now();
+}
+
+
+// Handle the complete frame received
+static void handle()
+{
+    const uint8_t type = rx_[1];
+    const uint16_t len = length();
+    const uint8_t* payload = rx_ + headerSize;
+
+    if (crc16(rx_ + 1, headerSize - 1 + len) != word(payload + len))
+    {
+        sendReply(type, badCrc);
+        return;
+    }
+
+    switch (type)
+    {
+        case command:
+            if (len < 1 || !command_)
+            {
+                sendReply(type, badArgs);
+            }
+            else
+            {
+                pos_ = 1;
+                failed_ = false;
+
+                const bool handled = command_(payload[0]);
+
+                sendReply
+                (
+                    type,
+                    !handled ? unknownCommand : failed_ ? failed : ok
+                );
+            }
+            break;
+
+        case get:
+            {
+                const uint16_t n = word(payload + 3);
+                uint8_t data[maxPayload - 1];
+
+                if
+                (
+                    len != 5
+                 || n > sizeof(data)
+                 || !ConfigStore::get(payload[0], word(payload + 1), data, n)
+                )
+                {
+                    sendReply(type, badArgs);
+                }
+                else
+                {
+                    sendReply(type, ok, data, n);
+                }
+            }
+            break;
+
+        case set:
+            if
+            (
+                len < 3
+             || !ConfigStore::set
+                (
+                    payload[0],
+                    word(payload + 1),
+                    payload + 3,
+                    len - 3
+                )
+            )
+            {
+                sendReply(type, badArgs);
+            }
+            else
+            {
+                sendReply(type, ok);
+            }
+            break;
+
+        case layout:
+            {
+                uint8_t data[4 + 2*ConfigStore::maxSections];
+                data[0] = ConfigStore::version;
+                data[1] = ConfigStore::nProfiles;
+                data[2] = ConfigStore::profile();
+
+                uint16_t sizes[ConfigStore::maxSections];
+                data[3] = ConfigStore::layout(sizes);
+                memcpy(data + 4, sizes, 2*data[3]);
+
+                sendReply(type, ok, data, 4 + 2*data[3]);
+            }
+            break;
+
+        case status:
+            {
+                storeStatus s;
+                ConfigStore::status(s);
+                sendReply(type, ok, &s, sizeof(s));
+            }
+            break;
+
+        default:
+            sendReply(type, badType);
+    }
+}
+
+
+// -----------------------------------------------------------------------------
+
+void ConfigProtocol::begin(bool (*command)(const char cmd))
+{
+    command_ = command;
+}
+
+
+void ConfigProtocol::poll()
+{
+    if (nRx_ && millis() - lastRx_ > frameTimeout)
+    {
+        nRx_ = 0;
+    }
+
+    while (Serial.available())
+    {
+        const uint8_t c = Serial.read();
+        lastRx_ = millis();
+
+        // Discard the bytes outside a frame
+        if (nRx_ == 0 && c != start)
+        {
+            continue;
+        }
+
+        rx_[nRx_++] = c;
+
+        if (nRx_ < headerSize)
+        {
+            continue;
+        }
+
+        if (length() > maxPayload)
+        {
+            nRx_ = 0;
+        }
+        else if (nRx_ == headerSize + length() + crcSize)
+        {
+            handle();
+            nRx_ = 0;
+        }
+    }
+}
+
+
+bool ConfigProtocol::read(void* data, const uint16_t n)
+{
+    if (pos_ + n > length())
+    {
+        failed_ = true;
+        return false;
+    }
+
+    memcpy(data, rx_ + headerSize + pos_, n);
+    pos_ += n;
+
+    return true;
+}
+
+
+void ConfigProtocol::fail()
+{
+    failed_ = true;
+}
+
+
+// -----------------------------------------------------------------------------
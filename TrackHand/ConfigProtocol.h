@@ -0,0 +1,64 @@
+/// Copyright 2014 Henry G. Weller
+// -----------------------------------------------------------------------------
+//  This file is part of
+/// ---     TrackHand: DataHand with Laser TrackBall
+// -----------------------------------------------------------------------------
+//
+//  TrackHand is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  TrackHand is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+//  for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with TrackHand.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+/// Title: Framed configuration protocol
+///  Description:
+//    Receives the frames of the configuration protocol described in
+//    ConfigFrame.h from Serial and replies to each.  Command frames are
+//    dispatched to the configure(cmd) functions of the subsystems which read
+//    the value following the command from the frame.  Get and set frames
+//    read and write many parameters of any profile of the ConfigStore in one
+//    round trip, e.g. a complete section or the acceleration curve, and the
+//    layout and status frames describe the store.
+//
+//    Bytes received outside a frame are discarded, as are incomplete frames
+//    once no further byte has been received for a while.
+// -----------------------------------------------------------------------------
+
+#ifndef ConfigProtocol_H
+#define ConfigProtocol_H
+
+#include "WProgram.h"
+#include "ConfigFrame.h"
+
+// -----------------------------------------------------------------------------
+
+namespace ConfigProtocol
+{
+    //- Set the function dispatching the command frames to the subsystems,
+    //  returning false if the command is not handled
+    void begin(bool (*command)(const char cmd));
+
+    //- Receive the bytes available and reply to each complete frame,
+    //  called from the loop
+    void poll();
+
+    //- Read n bytes of the value following the command in the frame,
+    //  returning false and failing the command if there are too few
+    bool read(void* data, const uint16_t n);
+
+    //- Fail the command being handled
+    void fail();
+}
+
+
+// -----------------------------------------------------------------------------
+#endif // ConfigProtocol_H
+// -----------------------------------------------------------------------------
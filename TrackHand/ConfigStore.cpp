@@ -0,0 +1,499 @@
+/// Copyright 2014 Henry G. Weller
+// -----------------------------------------------------------------------------
+//  This file is part of
+/// ---     TrackHand: DataHand with Laser TrackBall
+// -----------------------------------------------------------------------------
+//
+//  TrackHand is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  TrackHand is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+//  for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with TrackHand.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+
+#include "ConfigStore.h"
+#include "CRC16.h"
+#include "EEPROMParameters.h"
+
+// -----------------------------------------------------------------------------
+
+// Magic number identifying the block, "TH"
+static const uint16_t magic = 0x4854;
+
+// Time without changes after which those staged are committed [ms]
+static const uint32_t quietTime = 5000;
+
+// Maximum total size of the sections in all the profiles
+static const uint16_t maxLength = 1024;
+
+// Block stored at the start of EEPROM
+struct block
+{
+    uint16_t magic;
+    uint8_t version;
+    uint8_t nSections;
+
+    // Size of the sizes table and the profiles, which the CRC covers
+    uint16_t length;
+    uint16_t crc;
+
+    // Number of commits which have written the block
+    uint32_t writes;
+
+    // Number of profiles and the profile selected, which is outside the CRC
+    // so that selecting a profile writes only this byte
+    uint8_t nProfiles;
+    uint8_t profile;
+
+    uint16_t sizes[ConfigStore::maxSections];
+
+    // The sections of each profile in turn
+    uint8_t data[maxLength];
+};
+
+static const uint16_t headerSize = offsetof(block, sizes);
+
+// State of the block found at startup
+enum status
+{
+    blank,
+    corrupt,
+    otherVersion,
+    valid
+};
+
+static const char* statusNames[] = {"blank", "corrupt", "other version", "valid"};
+
+// The block as stored in EEPROM and the RAM mirror of the parameters
+static block stored_;
+static block mirror_;
+
+// Total size of the sections registered, i.e. of each profile
+static uint16_t used_ = 0;
+
+// Sections loaded, one bit each
+static uint8_t loaded_ = 0;
+
+// The sections of the profile selected in the mirror
+static uint8_t* active_ = mirror_.data;
+
+// Set when a profile is selected until changed() is called
+static bool changed_ = false;
+
+static status status_ = blank;
+
+// Set if any section was migrated from a shorter one
+static bool migrated_ = false;
+
+// Set while changes are staged in the mirror and the time of the last
+static bool dirty_ = false;
+static uint32_t lastChange_ = 0;
+
+// Number of commits and bytes written since startup
+static uint32_t commits_ = 0;
+static uint32_t bytesWritten_ = 0;
+
+// Set when the block has been invalidated until the restart by update()
+static bool resetPending_ = false;
+
+
+// -----------------------------------------------------------------------------
+
+uint16_t ConfigStore::add(const uint16_t size)
+{
+    const uint16_t offset = used_;
+
+    if
+    (
+        mirror_.nSections < maxSections
+     && uint16_t(used_ + size)*nProfiles <= maxLength
+    )
+    {
+        mirror_.sizes[mirror_.nSections++] = size;
+        used_ += size;
+    }
+
+    return offset;
+}
+
+
+void ConfigStore::begin()
+{
+    eeprom_read_block(&stored_, 0, sizeof(stored_));
+
+    const uint16_t bodyMax = sizeof(stored_) - headerSize;
+
+    if (stored_.magic != magic)
+    {
+        status_ = blank;
+    }
+    else if (stored_.version != version)
+    {
+        status_ = otherVersion;
+    }
+    else if
+    (
+        stored_.nSections > maxSections
+     || stored_.nProfiles == 0
+     || stored_.length < sizeof(stored_.sizes)
+     || stored_.length > bodyMax
+     || crc16(stored_.sizes, stored_.length) != stored_.crc
+    )
+    {
+        status_ = corrupt;
+    }
+    else
+    {
+        status_ = valid;
+    }
+
+    mirror_.magic = magic;
+    mirror_.version = version;
+    mirror_.length = sizeof(mirror_.sizes) + nProfiles*used_;
+    mirror_.writes = status_ == valid ? stored_.writes : 0;
+    mirror_.nProfiles = nProfiles;
+    mirror_.profile = status_ == valid ? stored_.profile % nProfiles : 0;
+    active_ = mirror_.data + mirror_.profile*used_;
+}
+
+
+void ConfigStore::load(const uint16_t offset, void* params, const uint16_t size)
+{
+    if (offset + size > used_)
+    {
+        return;
+    }
+
+    // Find the section and its offset in each profile of the block stored
+    uint8_t i = 0;
+    uint16_t o = 0;
+    uint16_t storedOffset = 0;
+
+    while (o != offset && i < mirror_.nSections)
+    {
+        o += mirror_.sizes[i];
+        storedOffset += stored_.sizes[i];
+        i++;
+    }
+
+    // Not the start of a section added
+    if (o != offset || i >= mirror_.nSections)
+    {
+        return;
+    }
+
+    if (!(loaded_ & (1 << i)))
+    {
+        loaded_ |= 1 << i;
+
+        uint16_t storedUsed = 0;
+
+        for (uint8_t j=0; j<stored_.nSections && j<maxSections; j++)
+        {
+            storedUsed += stored_.sizes[j];
+        }
+
+        const uint16_t storedData = stored_.length - sizeof(stored_.sizes);
+
+        // Set the section of each profile from that stored or the defaults
+        for (uint8_t p=0; p<nProfiles; p++)
+        {
+            uint8_t* section = mirror_.data + p*used_ + offset;
+            memcpy(section, params, size);
+
+            if
+            (
+                status_ == valid
+             && i < stored_.nSections
+             && p < stored_.nProfiles
+            )
+            {
+                const uint16_t n = min(stored_.sizes[i], size);
+                const uint16_t so = p*storedUsed + storedOffset;
+
+                if (so + n <= storedData)
+                {
+                    memcpy(section, stored_.data + so, n);
+                    migrated_ = migrated_ || n < size;
+                }
+            }
+        }
+    }
+
+    memcpy(params, active_ + offset, size);
+}
+
+
+void ConfigStore::commit()
+{
+    // The block invalidated by reset() must not be rewritten
+    if (resetPending_)
+    {
+        return;
+    }
+
+    dirty_ = false;
+
+    mirror_.crc = crc16(mirror_.sizes, mirror_.length);
+
+    const uint8_t* m = reinterpret_cast<const uint8_t*>(&mirror_);
+    uint8_t* s = reinterpret_cast<uint8_t*>(&stored_);
+    const uint16_t n = headerSize + mirror_.length;
+
+    // Count only the commits which change the block
+    const uint32_t writes = mirror_.writes;
+    mirror_.writes = stored_.writes;
+
+    if (memcmp(m, s, n) == 0)
+    {
+        mirror_.writes = writes;
+        return;
+    }
+
+    mirror_.writes = writes + 1;
+    commits_++;
+
+    // Write only the runs of bytes which differ from those stored
+    uint16_t i = 0;
+
+    while (i < n)
+    {
+        if (m[i] == s[i])
+        {
+            i++;
+            continue;
+        }
+
+        uint16_t j = i + 1;
+
+        while (j < n && m[j] != s[j])
+        {
+            j++;
+        }
+
+        eeprom_write_block(m + i, reinterpret_cast<void*>(i), j - i);
+        memcpy(s + i, m + i, j - i);
+        bytesWritten_ += j - i;
+        i = j;
+    }
+}
+
+
+void ConfigStore::update()
+{
+    // Restart after the reply to the reset command has been sent
+    if (resetPending_)
+    {
+        Serial.send_now();
+        delay(100);
+
+        // Request a system reset
+        SCB_AIRCR = 0x05FA0004;
+    }
+
+    if (dirty_ && millis() - lastChange_ > quietTime)
+    {
+        commit();
+    }
+}
+
+
+void ConfigStore::select(const uint8_t profile)
+{
+    if (profile < nProfiles && profile != mirror_.profile)
+    {
+        mirror_.profile = profile;
+        active_ = mirror_.data + profile*used_;
+        changed_ = true;
+
+        dirty_ = true;
+        lastChange_ = millis();
+    }
+}
+
+
+uint8_t ConfigStore::profile()
+{
+    return mirror_.profile;
+}
+
+
+bool ConfigStore::changed()
+{
+    const bool c = changed_;
+    changed_ = false;
+    return c;
+}
+
+
+uint32_t ConfigStore::writes()
+{
+    return mirror_.writes;
+}
+
+
+void ConfigStore::reset()
+{
+    const uint16_t zero = 0;
+    eeprom_write_block(&zero, 0, sizeof(zero));
+
+    // Restart from update() so that the command is answered first
+    resetPending_ = true;
+}
+
+
+void ConfigStore::get(const uint16_t offset, void* data, const uint16_t n)
+{
+    if (offset + n <= used_)
+    {
+        memcpy(data, active_ + offset, n);
+    }
+}
+
+
+void ConfigStore::set(const uint16_t offset, const void* data, const uint16_t n)
+{
+    if (offset + n <= used_)
+    {
+        memcpy(active_ + offset, data, n);
+        dirty_ = true;
+        lastChange_ = millis();
+    }
+}
+
+
+bool ConfigStore::get
+(
+    const uint8_t profile,
+    const uint16_t offset,
+    void* data,
+    const uint16_t n
+)
+{
+    const uint8_t p = profile == ConfigFrame::selected ? mirror_.profile : profile;
+
+    if (p >= nProfiles || offset + n > used_)
+    {
+        return false;
+    }
+
+    memcpy(data, mirror_.data + p*used_ + offset, n);
+
+    return true;
+}
+
+
+bool ConfigStore::set
+(
+    const uint8_t profile,
+    const uint16_t offset,
+    const void* data,
+    const uint16_t n
+)
+{
+    const uint8_t p = profile == ConfigFrame::selected ? mirror_.profile : profile;
+
+    if (p >= nProfiles || offset + n > used_)
+    {
+        return false;
+    }
+
+    memcpy(mirror_.data + p*used_ + offset, data, n);
+    dirty_ = true;
+    lastChange_ = millis();
+    changed_ = changed_ || p == mirror_.profile;
+
+    return true;
+}
+
+
+uint8_t ConfigStore::layout(uint16_t sizes[maxSections])
+{
+    memcpy(sizes, mirror_.sizes, mirror_.nSections*sizeof(sizes[0]));
+
+    return mirror_.nSections;
+}
+
+
+void ConfigStore::status(ConfigFrame::storeStatus& s)
+{
+    s.stored = status_;
+    s.migrated = migrated_;
+    s.version = version;
+    s.nProfiles = nProfiles;
+    s.profile = mirror_.profile;
+    s.pending = dirty_;
+    s.length = mirror_.length;
+    s.writes = mirror_.writes;
+    s.commits = commits_;
+    s.bytesWritten = bytesWritten_;
+}
+
+
+bool ConfigStore::configure(const char cmd)
+{
+    switch (cmd)
+    {
+        case 'R':
+            reset();
+            return true;
+            break;
+        case 'P':
+            {
+                uint8_t profile;
+
+                if (readValue("profile", profile))
+                {
+                    select(profile);
+                    Serial.print("TrackHand: selecting profile ");
+                    Serial.print(profile);
+
+                    if (profile < nProfiles)
+                    {
+                        Serial.println(" successful");
+                    }
+                    else
+                    {
+                        ConfigProtocol::fail();
+                        Serial.println(" failed");
+                    }
+                }
+            }
+            return true;
+            break;
+        case 'p':
+            Serial.print("ConfigStore profile ");
+            Serial.print(mirror_.profile);
+            Serial.print(" of ");
+            Serial.println(nProfiles);
+            Serial.print("ConfigStore version ");
+            Serial.print(version);
+            Serial.print(" length ");
+            Serial.print(mirror_.length);
+            Serial.print(" stored ");
+            Serial.print(statusNames[status_]);
+            Serial.println(migrated_ ? " migrated" : "");
+            Serial.print("ConfigStore writes ");
+            Serial.print(mirror_.writes);
+            Serial.print(" since startup ");
+            Serial.print(commits_);
+            Serial.print(" bytes ");
+            Serial.print(bytesWritten_);
+            Serial.println(dirty_ ? " pending" : "");
+            return true;
+            break;
+    }
+
+    return false;
+}
+
+
+// -----------------------------------------------------------------------------
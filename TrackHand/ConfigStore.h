@@ -0,0 +1,165 @@
+/// Copyright 2014 Henry G. Weller
+// -----------------------------------------------------------------------------
+//  This file is part of
+/// ---     TrackHand: DataHand with Laser TrackBall
+// -----------------------------------------------------------------------------
+//
+//  TrackHand is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  TrackHand is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+//  for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with TrackHand.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+/// Title: Configuration parameter store
+///  Description:
+//    Holds the configuration parameters of the subsystems as a single block
+//    in EEPROM, read at startup in one transfer into a RAM mirror from which
+//    the parameters are then read.
+//
+//    The block starts with a header holding a magic number, the schema
+//    version, the length, a count of the writes of the block and a CRC-16
+//    of the remainder, which is the table
+//    of the sizes of the sections followed by the sections themselves.  Each
+//    subsystem registers the section for its parameters structure from its
+//    constructor, so the sections are laid out in order of construction.
+//
+//    If the block is blank, corrupt or of another schema version the
+//    subsystems keep their default parameters and the block is rewritten
+//    from them.  A section stored shorter than its structure, i.e. from
+//    before fields were appended to it, is migrated by loading the stored
+//    fields and keeping the defaults of those appended.
+//
+//    The block holds nProfiles complete copies of the sections, one of which
+//    is selected and read and set through a pointer to it in the mirror, so
+//    that selecting another profile writes only the index of the profile
+//    selected.  After selection the subsystems reconfigure from the sections
+//    of the new profile.
+//
+//    Changes are staged in the mirror and committed together once no
+//    further change has been made for a few seconds, writing only the bytes
+//    which differ from those stored to limit the wear of the EEPROM.
+// -----------------------------------------------------------------------------
+
+#ifndef ConfigStore_H
+#define ConfigStore_H
+
+#include "WProgram.h"
+#include "ConfigFrame.h"
+
+// -----------------------------------------------------------------------------
+
+namespace ConfigStore
+{
+    //- Schema version, changed only if existing fields are changed or
+    //  removed rather than appended to a section
+    const uint8_t version = 3;
+
+    //- Number of profiles stored
+    const uint8_t nProfiles = 4;
+
+    //- Maximum number of sections
+    const uint8_t maxSections = 8;
+
+    //- Register a section of the given size, returning its offset
+    uint16_t add(const uint16_t size);
+
+    //- Read the block from EEPROM into the RAM mirror and check it
+    void begin();
+
+    //- Load the section at offset of the profile selected into the
+    //  parameters.  On the first load of the section each profile is set
+    //  from the block read, or from the parameters which hold the defaults.
+    //  Nothing is loaded if the offset is not that of a section added.
+    void load(const uint16_t offset, void* params, const uint16_t size);
+
+    //- Write the block to EEPROM if the mirror differs from it
+    void commit();
+
+    //- Commit the changes staged once none has been made for a while,
+    //  or restart if reset() has been called, called from the loop after
+    //  the configuration frames are handled
+    void update();
+
+    //- Select the profile from which the sections are read and set
+    void select(const uint8_t profile);
+
+    //- Return the profile selected
+    uint8_t profile();
+
+    //- Return true once if a profile has been selected, or the profile
+    //  selected set by a frame, since the last call so that the subsystems
+    //  are reconfigured from it
+    bool changed();
+
+    //- Return the number of commits which have written the block
+    uint32_t writes();
+
+    //- Invalidate the block so that the defaults are restored on the
+    //  restart done by the next update()
+    void reset();
+
+    //- Copy n bytes from the profile selected at offset
+    void get(const uint16_t offset, void* data, const uint16_t n);
+
+    //- Copy n bytes to the profile selected at offset staging them for commit
+    void set(const uint16_t offset, const void* data, const uint16_t n);
+
+    //- Copy n bytes from the profile, or that selected, at offset
+    //  returning false if out of range
+    bool get
+    (
+        const uint8_t profile,
+        const uint16_t offset,
+        void* data,
+        const uint16_t n
+    );
+
+    //- Copy n bytes to the profile, or that selected, at offset staging them
+    //  for commit and reconfiguration, returning false if out of range
+    bool set
+    (
+        const uint8_t profile,
+        const uint16_t offset,
+        const void* data,
+        const uint16_t n
+    );
+
+    //- Copy the size of each section returning the number of sections
+    uint8_t layout(uint16_t sizes[maxSections]);
+
+    //- Return the state of the store
+    void status(ConfigFrame::storeStatus& s);
+
+    //- Return the value at offset
+    template<typename Type>
+    Type read(const uint16_t offset)
+    {
+        Type val;
+        get(offset, &val, sizeof(val));
+        return val;
+    }
+
+    //- Set the value at offset
+    template<typename Type>
+    void write(const uint16_t offset, const Type& val)
+    {
+        set(offset, &val, sizeof(val));
+    }
+
+    //- Reset to defaults ('R'), select a profile ('P') and print the status
+    //  of the block ('p')
+    bool configure(const char cmd);
+}
+
+
+// -----------------------------------------------------------------------------
+#endif // ConfigStore_H
+// -----------------------------------------------------------------------------
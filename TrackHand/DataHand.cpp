@@ -21,7 +21,8 @@
 /// Title: Main function
 ///  Description:
 //    Constructs the KeyMatrix, TrackBall and PowerSave classes
-//    and enters the matrix scan loop.
+//    and enters the matrix scan loop, timed relative to the USB
+//    start-of-frame by FrameSync.
 //    The trackball operates pointer movement on interrupt.
 //    The trackball may also be used for scrolling selected by appropriate key.
 // -----------------------------------------------------------------------------
@@ -29,31 +30,70 @@
 #include "KeyMatrix.h"
 #include "TrackBall.h"
 #include "PowerSave.h"
+#include "USBStatistics.h"
+#include "FrameSync.h"
+#include "Idle.h"
 #include "MCP23018.h"
-#include "EEPROMParameters.h"
+#include "ConfigStore.h"
+#include "ConfigProtocol.h"
 
 // -----------------------------------------------------------------------------
 
-// Construct the keyboard matrix
-// with the parameters stored in EEPROM starting at 0
-KeyMatrix keyMatrix(0);
+// Construct the keyboard matrix,
+// registering the first section of the ConfigStore for its parameters
+KeyMatrix keyMatrix;
 
-// Construct the trackball
-// with the parameters stored in EEPROM starting immediately after the keyMatrix
-TrackBall trackBall(keyMatrix.eepromEnd());
+// Construct the trackball,
+// registering the section after the keyMatrix for its parameters
+TrackBall trackBall;
+
+// Construct the power-saving mode for the keyboard and trackball,
+// registering the section after the trackBall for its parameters
+PowerSave powerSave(keyMatrix, trackBall);
+
+// Construct the reporting of the USB packet-pool statistics
+USBStatistics usbStatistics;
+
+// Construct the scheduling of the scan loop relative to the USB
+// start-of-frame, iterating every polling interval of the mouse endpoint
+// so that each poll is answered by a report sampled just before it
+FrameSync frameSync(MOUSE_INTERVAL);
+
+// Dispatch the configuration commands to the subsystems
+static bool configure(const char command)
+{
+    bool handled = false;
+
+    handled |= keyMatrix.configure(command);
+    handled |= trackBall.configure(command);
+    handled |= powerSave.configure(command);
+    handled |= usbStatistics.configure(command);
+    handled |= ConfigStore::configure(command);
+
+    return handled;
+}
 
-// Construct the power-saving mode for the keyboard and trackball
-// with the parameters stored in EEPROM starting immediately after the trackBall
-PowerSave powerSave(keyMatrix, trackBall, trackBall.eepromEnd());
 
 int main(void)
 {
+    Idle::begin();
+    ConfigStore::begin();
+    ConfigProtocol::begin(configure);
     keyMatrix.begin();
     trackBall.begin();
     powerSave.begin();
 
+    // Write the parameters loaded back to EEPROM if the block stored was
+    // blank, invalid or migrated
+    ConfigStore::commit();
+
     while (1)
     {
+        frameSync.start();
+
+        // Start reading the ball motion while the keys are scanned
+        trackBall.readMotion();
+
         // Put into power-save mode when keys are not pressed
         // or trackball not moved for some time
         powerSave
@@ -65,27 +105,29 @@ int main(void)
          || trackBall.moveOrScroll(!keyMatrix.scroll())
         );
 
-        if (Serial.available())
+        frameSync.queued();
+
+        // Handle the configuration frames received
+        ConfigProtocol::poll();
+
+        // Reconfigure from the profile selected or set by key or frame
+        if (ConfigStore::changed())
         {
-            uint8_t command = Serial.read();
-
-            bool handled = false;
-
-            handled |= keyMatrix.configure(command);
-            handled |= trackBall.configure(command);
-            handled |= powerSave.configure(command);
-
-            if (!handled)
-            {
-                // Discard any buffered input
-                usb_serial_flush_input();
-                Serial.print("TrackHand: configuration command ");
-                Serial.print(command);
-                Serial.println(" failed");
-            }
+            keyMatrix.configure();
+            trackBall.configure();
+            powerSave.configure();
         }
 
-        keyMatrix.pause();
+        // Write the configuration changes once they have stopped, or restart
+        // once a reset command has been answered
+        ConfigStore::update();
+
+        // Wait to sample just before the host next polls, or pause if
+        // scanning slowly to save power or USB frames are not being received
+        if (keyMatrix.slowScan() || !frameSync.wait())
+        {
+            keyMatrix.pause();
+        }
     }
 
     return 0;
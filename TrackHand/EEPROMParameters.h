@@ -20,20 +20,23 @@
 // -----------------------------------------------------------------------------
 /// Title: EEPROM configuration parameter management
 ///  Description:
-//    Getters and setters for configuration parameters stored in EEPROM.
+//    Getters and setters for configuration parameters held in the sections
+//    of the ConfigStore, addressed by their offset in it, and for setting
+//    them from the value following the command in a configuration frame.
 // -----------------------------------------------------------------------------
 
 #ifndef EEPROMParameters_H
 #define EEPROMParameters_H
 
+#include "ConfigStore.h"
+#include "ConfigProtocol.h"
+
 // -----------------------------------------------------------------------------
 
 template<typename Type>
 Type eepromRead(const uint address)
 {
-    Type val;
-    eeprom_read_block(&val, (uint8_t*)address, sizeof(val));
-    return val;
+    return ConfigStore::read<Type>(address);
 }
 
 
@@ -42,48 +45,51 @@ void eepromStore(const uint address, const Type val)
 {
     if (val != eepromRead<Type>(address))
     {
-        eeprom_write_block(&val, (uint8_t*)address, sizeof(val));
+        ConfigStore::write(address, val);
+    }
+}
+
+
+//- Read the value following the command in the configuration frame
+template<typename Type>
+bool readValue
+(
+    const char* propName,
+    Type& value
+)
+{
+    if (ConfigProtocol::read(&value, sizeof(Type)))
+    {
+        return true;
     }
+
+    Serial.print("TrackHand: setting ");
+    Serial.print(propName);
+    Serial.println(" failed");
+
+    return false;
 }
 
 
 template<typename Type>
-bool eepromStoreFromSerial
+bool eepromStoreFromFrame
 (
-    const char cmd,
     const char* propName,
     const uint address
 )
 {
-    const uint8_t n = 2*sizeof(Type);
+    Type value;
 
-    if (Serial.available() >= n)
+    if (readValue(propName, value))
     {
-        Type value;
-        Serial.readBytes((char *)(&value), sizeof(Type));
-        Type check;
-        Serial.readBytes((char *)(&check), sizeof(Type));
-
-        // Simple parity check of the data provided
-        if ((cmd ^ value) == check)
-        {
-            eepromStore(address, value);
-            Serial.print("TrackHand: setting ");
-            Serial.print(propName);
-            Serial.print(" to ");
-            Serial.print(value);
-            Serial.println(" successful");
-
-            return true;
-        }
-        else
-        {
-            // Discard any buffered input
-            usb_serial_flush_input();
-            Serial.print("TrackHand: setting ");
-            Serial.print(propName);
-            Serial.println(" failed");
-        }
+        eepromStore(address, value);
+        Serial.print("TrackHand: setting ");
+        Serial.print(propName);
+        Serial.print(" to ");
+        Serial.print(value);
+        Serial.println(" successful");
+
+        return true;
     }
 
     return false;
@@ -98,15 +104,14 @@ Type eepromRead(const uint address, const Type)
 }
 
 template<typename Type>
-bool eepromStoreFromSerial
+bool eepromStoreFromFrame
 (
-    const char cmd,
     const char* propName,
     const uint address,
     const Type
 )
 {
-    return eepromStoreFromSerial<Type>(cmd, propName, address);
+    return eepromStoreFromFrame<Type>(propName, address);
 }
 
 #define PROP_ADDR(x)                                                           \
@@ -118,10 +123,9 @@ bool eepromStoreFromSerial
 #define eepromSet(property, val)                                               \
     eepromStore(PROP_ADDR(property), val)
 
-#define eepromSetFromSerial(cmd, property)                                     \
-    eepromStoreFromSerial                                                      \
+#define eepromSetFromFrame(property)                                           \
+    eepromStoreFromFrame                                                       \
     (                                                                          \
-        cmd,                                                                   \
         #property,                                                             \
         PROP_ADDR(property),                                                   \
         ((parameters*)(NULL))->property                                        \
@@ -0,0 +1,95 @@
+/// Copyright 2014 Henry G. Weller
+// -----------------------------------------------------------------------------
+//  This file is part of
+/// ---     TrackHand: DataHand with Laser TrackBall
+// -----------------------------------------------------------------------------
+//
+//  TrackHand is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  TrackHand is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+//  for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with TrackHand.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+
+#include "FrameSync.h"
+#include "Idle.h"
+#include "usb_dev.h"
+
+// -----------------------------------------------------------------------------
+
+FrameSync::FrameSync(const uint8_t frames)
+:
+    frames_(frames)
+{}
+
+
+// -----------------------------------------------------------------------------
+
+void FrameSync::queued()
+{
+    const uint32_t t = micros() - start_;
+
+    if (t >= maxSampleTime_)
+    {
+        sampleTime_ = maxSampleTime_;
+    }
+    else if (t > sampleTime_)
+    {
+        sampleTime_ = t;
+    }
+    else
+    {
+        sampleTime_ -= (sampleTime_ - t) >> 3;
+    }
+}
+
+
+bool FrameSync::wait()
+{
+    // Take a consistent copy of the last start of frame
+    __disable_irq();
+    const uint32_t sofTime = usb_sof_time;
+    const uint32_t sofCount = usb_sof_count;
+    __enable_irq();
+
+    const uint32_t now = micros();
+
+    if (!usb_configuration || now - sofTime > 2*framePeriod_)
+    {
+        return false;
+    }
+
+    const uint32_t lead = sampleTime_ + margin_;
+
+    // Number of frames after the last at which sampling can start
+    // no earlier than now
+    const int32_t earliest =
+        (now - sofTime + lead + framePeriod_ - 1)/framePeriod_;
+
+    // Step to the next frame of the loop unless that has been overrun or the
+    // phase lost, e.g. after sleep, in which case take the first that can be
+    // met
+    frame_ += frames_;
+    int32_t n = frame_ - sofCount;
+
+    if (n < earliest || n >= earliest + frames_)
+    {
+        n = earliest;
+        frame_ = sofCount + n;
+    }
+
+    Idle::until(sofTime + n*framePeriod_ - lead);
+
+    return true;
+}
+
+
+// -----------------------------------------------------------------------------
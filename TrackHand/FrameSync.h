@@ -0,0 +1,99 @@
+/// Copyright 2014 Henry G. Weller
+// -----------------------------------------------------------------------------
+//  This file is part of
+/// ---     TrackHand: DataHand with Laser TrackBall
+// -----------------------------------------------------------------------------
+//
+//  TrackHand is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  TrackHand is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+//  for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with TrackHand.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+/// Title: USB start-of-frame phase-locked sampling
+///  Description:
+//    Schedules the start of each iteration of the scan loop relative to the
+//    USB start-of-frame so that the trackball motion burst and the final row
+//    of the key scan complete, and the reports are queued, just before the
+//    start of the frame in which the host next polls rather than at a random
+//    phase of the polling interval.  The time taken to sample and queue the
+//    reports is measured each iteration and tracked, rising immediately and
+//    decaying slowly.
+//
+//    When USB frames are not being received, e.g. while suspended or before
+//    configuration, no wait is done and the caller falls back to the
+//    free-running loop delay.
+// -----------------------------------------------------------------------------
+
+#ifndef FrameSync_H
+#define FrameSync_H
+
+#include "WProgram.h"
+
+// -----------------------------------------------------------------------------
+
+class FrameSync
+{
+    //- USB full-speed frame period (us)
+    static const uint16_t framePeriod_ = 1000;
+
+    //- Number of frames per loop iteration
+    const uint8_t frames_;
+
+    //- Margin before the start of frame by which the reports are queued (us)
+    const uint16_t margin_ = 100;
+
+    //- Maximum sampling time tracked, limiting the effect of a blocked send (us)
+    const uint16_t maxSampleTime_ = 2000;
+
+    //- Time taken to sample and queue the reports (us)
+    uint16_t sampleTime_ = 800;
+
+    //- Count of the start of frame the current reports are to precede
+    uint32_t frame_ = 0;
+
+    //- Time sampling started (us)
+    uint32_t start_ = 0;
+
+
+public:
+
+    //- Construct to iterate every given number of frames
+    FrameSync(const uint8_t frames);
+
+
+    // Member functions
+
+        //- Mark the start of sampling
+        void start()
+        {
+            start_ = micros();
+        }
+
+        //- Mark the reports queued and update the sampling time
+        void queued();
+
+        //- Wait until sampling should start for the reports to be queued just
+        //  before the start of frame.  Returns false without waiting if USB
+        //  frames are not being received.
+        bool wait();
+
+        //- Return the current sampling time (us)
+        uint16_t sampleTime() const
+        {
+            return sampleTime_;
+        }
+};
+
+
+// -----------------------------------------------------------------------------
+#endif // FrameSync_H
+// -----------------------------------------------------------------------------
@@ -0,0 +1,87 @@
+/// Copyright 2014 Henry G. Weller
+// -----------------------------------------------------------------------------
+//  This file is part of
+/// ---     TrackHand: DataHand with Laser TrackBall
+// -----------------------------------------------------------------------------
+//
+//  TrackHand is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  TrackHand is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+//  for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with TrackHand.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+
+#include "Idle.h"
+#include "IntervalTimer.h"
+
+// -----------------------------------------------------------------------------
+
+// Shortest wait for which the core is put to sleep (us)
+static const uint32_t minSleepTime = 20;
+
+// Time from the timer interrupt to resuming after the WFI (us)
+static const uint32_t wakeLatency = 2;
+
+// Set while the wake-up timer is running
+static volatile bool armed = false;
+
+// Called from pit3_isr when the wake-up timer expires
+static void expired()
+{
+    PIT_TCTRL3 = 0;
+    armed = false;
+}
+
+
+// -----------------------------------------------------------------------------
+
+void Idle::begin()
+{
+    SIM_SCGC6 |= SIM_SCGC6_PIT;
+    PIT_MCR = 0;
+    PIT_TCTRL3 = 0;
+    IntervalTimer::PIT_ISR[3] = expired;
+    NVIC_ENABLE_IRQ(IRQ_PIT_CH3);
+}
+
+
+void Idle::until(const uint32_t deadline)
+{
+    const int32_t dt = deadline - micros();
+
+    if (dt > int32_t(minSleepTime))
+    {
+        armed = true;
+        PIT_LDVAL3 = (dt - wakeLatency)*(F_BUS_ACTUAL/1000000) - 1;
+        PIT_TCTRL3 = 3;
+
+        while (armed && int32_t(deadline - micros()) > 0)
+        {
+            // Check and sleep with interrupts masked so that the timer
+            // expiring in between still wakes the core from the WFI
+            __disable_irq();
+            if (armed)
+            {
+                asm volatile("wfi");
+            }
+            __enable_irq();
+        }
+
+        PIT_TCTRL3 = 0;
+        armed = false;
+    }
+
+    while (int32_t(deadline - micros()) > 0)
+    {}
+}
+
+
+// -----------------------------------------------------------------------------
@@ -0,0 +1,60 @@
+/// Copyright 2014 Henry G. Weller
+// -----------------------------------------------------------------------------
+//  This file is part of
+/// ---     TrackHand: DataHand with Laser TrackBall
+// -----------------------------------------------------------------------------
+//
+//  TrackHand is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  TrackHand is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+//  for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with TrackHand.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+/// Title: Interrupt-paced idle wait
+///  Description:
+//    Replaces the busy delays of the scan loop by sleeping the core with WFI
+//    until the deadline.  A one-shot on PIT channel 3 wakes the core at the
+//    deadline; any other interrupt, e.g. the SysTick, USB, trackball MOTION or
+//    serial RX, also wakes it and is serviced immediately, after which the
+//    wait resumes.  The few microseconds after the timer expires, and waits
+//    too short to be worth sleeping, are spun so that the loop cadence is
+//    unchanged.
+//
+//    PIT channel 0 paces the spi4teensy3 DMA so the wake-up timer is
+//    programmed directly rather than allocated from IntervalTimer.
+// -----------------------------------------------------------------------------
+
+#ifndef Idle_H
+#define Idle_H
+
+#include "WProgram.h"
+
+// -----------------------------------------------------------------------------
+
+namespace Idle
+{
+    //- Enable the PIT and the wake-up timer interrupt
+    void begin();
+
+    //- Sleep until micros() reaches the deadline
+    void until(const uint32_t deadline);
+
+    //- Sleep for the given time (us)
+    inline void wait(const uint32_t us)
+    {
+        until(micros() + us);
+    }
+}
+
+
+// -----------------------------------------------------------------------------
+#endif // Idle_H
+// -----------------------------------------------------------------------------
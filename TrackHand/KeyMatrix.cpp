@@ -21,6 +21,8 @@
 
 #include "KeyMatrix.h"
 #include "debug.h"
+#include "Idle.h"
+#include "ConfigStore.h"
 
 // -----------------------------------------------------------------------------
 
@@ -58,7 +60,7 @@ void KeyMatrix::scan()
         digitalWriteFast(rhRow, LOW);
         leftHand_.writeBit(lhRow, LOW);
 
-        delayMicroseconds(columnStabTime_);
+        Idle::wait(columnStabTime_);
 
         // Columns are ONLY on port A
         uint8_t lhColumns = leftHand_.readA();
@@ -111,6 +113,8 @@ bool KeyMatrix::send()
     // to avoid switching if the mode is locked
     bool modeKeyReleased = true;
 
+    bool profileKey = false;
+
     // Scan for mode and modifiers
     for (uint8_t keyi=0; keyi<nPressed_; keyi++)
     {
@@ -178,6 +182,10 @@ bool KeyMatrix::send()
                 case mouse3_:
                     mouseButtons[2] = 1;
                     break;
+
+                case profileKey_:
+                    profileKey = true;
+                    break;
             }
 
             // If mode set store the corresponding pressed key
@@ -209,6 +217,16 @@ bool KeyMatrix::send()
         }
     }
 
+    // Select the next configuration profile when the profile key is pressed
+    if (profileKey && !profileKeyPrev_)
+    {
+        ConfigStore::select
+        (
+            (ConfigStore::profile() + 1) % ConfigStore::nProfiles
+        );
+    }
+    profileKeyPrev_ = profileKey;
+
     uint8_t nSend = 0;
     KEYCODE_TYPE keyboardKeys[maxSend_] = {0, 0, 0, 0, 0, 0};
     bool unshiftedKeys = false;
@@ -254,33 +272,37 @@ bool KeyMatrix::send()
         modifiers |= MODIFIERKEY_SHIFT;
     }
 
-    // Check that some keys pressed have changed and transfer to send buffer
+    // Check that some keys pressed have changed
     bool keysChanged = false;
     for (uint8_t keyi=0; keyi<maxSend_; keyi++)
     {
-        keyboard_keys[keyi] = keyboardKeys[keyi];
-
         if (keyboardKeysPrev_[keyi] != keyboardKeys[keyi])
         {
             keysChanged = true;
         }
-
-        keyboardKeysPrev_[keyi] = keyboardKeys[keyi];
     }
 
-    // Set modifiers if changed
-    bool modifiersChanged = false;
-    if (modifiers != modifiersPrev_)
-    {
-        Keyboard.set_modifier(modifiers);
-        modifiersChanged = true;
-        modifiersPrev_ = modifiers;
-    }
+    bool modifiersChanged = modifiers != modifiersPrev_;
 
-    // Send if keys have changed
+    // Send if keys have changed without waiting for the host.
+    // If the report cannot be queued the previous keys are retained
+    // so that sending is retried on the next scan.
     if (keysChanged || modifiersChanged)
     {
-        Keyboard.send_now();
+        for (uint8_t keyi=0; keyi<maxSend_; keyi++)
+        {
+            keyboard_keys[keyi] = keyboardKeys[keyi];
+        }
+        Keyboard.set_modifier(modifiers);
+
+        if (Keyboard.send_latest())
+        {
+            for (uint8_t keyi=0; keyi<maxSend_; keyi++)
+            {
+                keyboardKeysPrev_[keyi] = keyboardKeys[keyi];
+            }
+            modifiersPrev_ = modifiers;
+        }
     }
 
     bool mouseButtonsChanged = false;
@@ -290,28 +312,51 @@ bool KeyMatrix::send()
         {
             mouseButtonsChanged = true;
         }
-
-        mouseButtonsPrev_[buttoni] = mouseButtons[buttoni];
     }
 
     if (mouseButtonsChanged)
     {
+        bool sent;
+
         // Special handling for double-click of button 1
+        // sent as press, release, press one report at a time so that
+        // sending is retried from the report which could not be queued
         if (mouseButtons[0] == 2)
         {
-            Mouse.set_buttons(1, 0, 0);
-            Mouse.set_buttons(0, 0, 0);
-            Mouse.set_buttons(1, 0, 0);
+            static const uint8_t doubleClick[3] = {1, 0, 1};
+
+            while
+            (
+                doubleClickSent_ < 3
+             && Mouse.set_buttons_latest(doubleClick[doubleClickSent_], 0, 0)
+            )
+            {
+                doubleClickSent_++;
+            }
+
+            sent = doubleClickSent_ == 3;
         }
         else
         {
-            Mouse.set_buttons
+            doubleClickSent_ = 0;
+
+            sent = Mouse.set_buttons_latest
             (
                 mouseButtons[0],
                 mouseButtons[1],
                 mouseButtons[2]
             );
         }
+
+        // Retain the previous buttons to retry on the next scan if not sent
+        if (sent)
+        {
+            for (uint8_t buttoni=0; buttoni<3; buttoni++)
+            {
+                mouseButtonsPrev_[buttoni] = mouseButtons[buttoni];
+            }
+            doubleClickSent_ = 0;
+        }
     }
 
     if (keysChanged || modifiersChanged || mouseButtonsChanged)
@@ -325,7 +370,7 @@ bool KeyMatrix::send()
 }
 
 
-KeyMatrix::KeyMatrix(const ptrdiff_t eepromStart)
+KeyMatrix::KeyMatrix()
 :
     leftHand_(Wire, 0),
     normalMode_(false, normalKeyMap, 31),
@@ -334,7 +379,7 @@ KeyMatrix::KeyMatrix(const ptrdiff_t eepromStart)
     fnMode_(true, functionKeyMap, 29),
     mouseMode_(true, functionKeyMap, 28),
     currentMode_(normalMode_.set(NULL)),
-    eepromStart_(eepromStart)
+    eepromStart_(ConfigStore::add(sizeof(parameters)))
 {}
 
 
@@ -393,6 +438,28 @@ void KeyMatrix::wake()
 }
 
 
+void KeyMatrix::wakeOnKey(const bool enable)
+{
+    for (uint8_t ri=0; ri<nRows_; ri++)
+    {
+        digitalWriteFast(rhRows_[ri], enable ? LOW : HIGH);
+    }
+
+    leftHand_.write(enable ? 0 : 0xffff);
+
+    uint8_t columnBits = 0;
+    if (enable)
+    {
+        for (uint8_t ci=0; ci<nColumns_; ci++)
+        {
+            bitSet(columnBits, lhColumns_[ci]);
+        }
+    }
+
+    leftHand_.interruptOnLowA(columnBits);
+}
+
+
 bool KeyMatrix::keysPressed()
 {
     scan();
@@ -402,7 +469,7 @@ bool KeyMatrix::keysPressed()
 
 void KeyMatrix::pause()
 {
-    delay(loopDelayTime_);
+    Idle::wait(1000*uint32_t(slowScan_ ? slowLoopDelayTime_ : loopDelayTime_));
 }
 
 
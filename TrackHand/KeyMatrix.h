@@ -104,6 +104,9 @@ class KeyMatrix
         // Keyboard programming mode
         static const KEYCODE_TYPE modeKeyPrgm_   = DH_MODE(0xe);
 
+        // Select the next configuration profile
+        static const KEYCODE_TYPE profileKey_    = DH_MODE(0xf);
+
         static const KEYCODE_TYPE normalKeyMap[nKeys];
         static const KEYCODE_TYPE shiftKeyMap[nKeys];
         static const KEYCODE_TYPE nasKeyMap[nKeys];
@@ -133,6 +136,12 @@ class KeyMatrix
         //- Matrix scan loop delay time (ms)
         const uint16_t loopDelayTime_ = 5;
 
+        //- Matrix scan loop delay time while scanning slowly (ms)
+        const uint16_t slowLoopDelayTime_ = 25;
+
+        //- Set while scanning slowly to save power
+        bool slowScan_ = false;
+
         //- Current mode
         const Mode *currentMode_;
 
@@ -144,6 +153,10 @@ class KeyMatrix
 
         uint8_t modeKeyPrev_ = 0;
 
+        //- Set while the profile key is held
+        //  Used to select the next profile once per press
+        bool profileKeyPrev_ = false;
+
         //- Key codes sent from previous call
         //  Used to avoid sending the same key codes repeatedly
         KEYCODE_TYPE keyboardKeysPrev_[maxSend_] = {0, 0, 0, 0, 0, 0};
@@ -155,6 +168,11 @@ class KeyMatrix
         //- Mouse buttons from previous call
         uint8_t mouseButtonsPrev_[3] = {0, 0, 0};
 
+        //- Number of the double-click button reports already queued
+        //  Used to resume the sequence where it stopped if a report cannot
+        //  be queued rather than repeating the click already sent
+        uint8_t doubleClickSent_ = 0;
+
         //- Set the current mode
         void set(const Mode& mode);
 
@@ -188,19 +206,20 @@ class KeyMatrix
         //- Send the pressed keys
         bool send();
 
-        //- Structure representing the storage of the parameters in EEPROM
+        //- Structure representing the storage of the parameters in the
+        //  ConfigStore, fields may only be appended
         struct parameters
         {
         };
 
-        //- Start of the EEPROM storage for the configuration parameters
+        //- Offset of the configuration parameters in the ConfigStore
         ptrdiff_t eepromStart_;
 
 
 public:
 
     //- Constructor
-    KeyMatrix(const ptrdiff_t eepromStart);
+    KeyMatrix();
 
 
     // Member functions
@@ -214,6 +233,18 @@ public:
         //- Wake after sleep
         void wake();
 
+        //- Set the I2C clock divider for the bus clock currently running,
+        //  called after it is changed
+        void clockChanged()
+        {
+            Wire.setRate(F_BUS_ACTUAL);
+        }
+
+        //- Drive all the rows and enable the left-hand interrupt so that any
+        //  key press pulls a column, or the interrupt, low to wake from deep
+        //  sleep, or restore the rows for scanning
+        void wakeOnKey(const bool enable);
+
         //- Configure from parameters stored in EEPROM
         void configure()
         {}
@@ -224,19 +255,24 @@ public:
             return false;
         }
 
-        //- Return the end of the EEPROM storage
-        //  for the configuration parameters
-        ptrdiff_t eepromEnd()
-        {
-            return eepromStart_ + sizeof(parameters);
-        }
-
         //- Scan matrix and send the pressed keys
         bool keysPressed();
 
         //- Loop pause to avoid overloading the USB HID interface
         void pause();
 
+        //- Select slow scanning to save power
+        void slowScan(const bool slow)
+        {
+            slowScan_ = slow;
+        }
+
+        //- Return true while scanning slowly
+        bool slowScan() const
+        {
+            return slowScan_;
+        }
+
         //- Add offset to key-code to indicate key is shifted
         static inline KEYCODE_TYPE shiftKeyCode(const KEYCODE_TYPE& key)
         {
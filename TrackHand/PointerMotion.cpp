@@ -0,0 +1,102 @@
+/// Copyright 2014 Henry G. Weller
+// -----------------------------------------------------------------------------
+//  This file is part of
+/// ---     TrackHand: DataHand with Laser TrackBall
+// -----------------------------------------------------------------------------
+//
+//  TrackHand is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  TrackHand is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+//  for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with TrackHand.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+
+#include "PointerMotion.h"
+
+// -----------------------------------------------------------------------------
+
+const uint16_t PointerMotion::accelRecip_[PointerMotion::nAccelIntervals_] =
+{
+    16000, 16000,  8000,  5333,  4000,  3200,  2667,  2286,
+     2000,  1778,  1600,  1455,  1333,  1231,  1143,  1067,
+     1000,   941,   889,   842,   800,   762,   727,   696,
+      667,   640,   615,   593,   571,   552,   533,   516
+};
+
+
+int32_t PointerMotion::accelGain
+(
+    const int16_t xy[2],
+    const uint32_t interval
+) const
+{
+    // Rounded interval limited to the range over which the ball is assumed
+    // to be moving
+    const uint32_t n =
+        (interval + (1 << (accelIntervalShift_ - 1))) >> accelIntervalShift_;
+
+    // Speed in counts per accelPeriod_ rather than per burst
+    const uint32_t speed =
+        (
+            (abs(xy[0]) + abs(xy[1]))
+           *accelRecip_[n < nAccelIntervals_ ? n : nAccelIntervals_ - 1]
+        ) >> accelRecipShift_;
+
+    if (speed == 0)
+    {
+        return accelCurve_[0];
+    }
+
+    // Power-of-two speed bucket k such that 2^k <= speed < 2^(k+1)
+    const uint8_t k = 31 - __builtin_clz(speed);
+
+    if (k >= nAccelPoints_ - 1)
+    {
+        return accelCurve_[nAccelPoints_ - 1];
+    }
+
+    // Interpolate between the points at 2^k and 2^(k+1)
+    // using the fraction of the way between them in units of 1/256
+    const int32_t frac = ((speed - (1 << k)) << 8) >> k;
+
+    return
+        accelCurve_[k]
+      + (((accelCurve_[k + 1] - accelCurve_[k])*frac) >> 8);
+}
+
+
+void PointerMotion::transfer(int16_t xy[2], const uint32_t interval)
+{
+    const int32_t gain = accelGain(xy, interval);
+    const uint8_t shift = scaleShift_ + accelShift_;
+
+    for (uint8_t i=0; i<2; i++)
+    {
+        // xy[0] moves the pointer in y and xy[1] in x
+        const int64_t v =
+            int64_t(xy[i])*scale_[1 - i]*gain + remainder_[i];
+
+        // Round down and carry the remainder, which is always positive,
+        // so that the sum of the motion sent is the sum of the scaled motion
+        int64_t out = v >> shift;
+        remainder_[i] = v - out*(int64_t(1) << shift);
+
+        // Motion beyond the report range is discarded rather than carried
+        // to limit the pointer speed
+        if (out > maxReport_) out = maxReport_;
+        if (out < -maxReport_) out = -maxReport_;
+
+        xy[i] = out;
+    }
+}
+
+
+// -----------------------------------------------------------------------------
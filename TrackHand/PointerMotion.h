@@ -0,0 +1,137 @@
+/// Copyright 2014 Henry G. Weller
+// -----------------------------------------------------------------------------
+//  This file is part of
+/// ---     TrackHand: DataHand with Laser TrackBall
+// -----------------------------------------------------------------------------
+//
+//  TrackHand is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  TrackHand is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+//  for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with TrackHand.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+/// Title: Pointer acceleration and scaling of the sensor motion
+///  Description:
+//    Applies the acceleration curve, indexed by the speed of the motion in
+//    counts per millisecond, and the independent x and y scale to the motion
+//    read from the sensor in fixed point.  The fractional remainder is
+//    carried to the next motion so that the sum of the motion sent equals
+//    the sum of the scaled motion, except for that clipped to the report
+//    range of +/-127 per report, which limits the pointer speed.
+//
+//    Independent of the hardware so that it is also compiled into the host
+//    simulator utilities/adnssim, which replays the sensor motion through it
+//    to check the drift.
+// -----------------------------------------------------------------------------
+
+#ifndef PointerMotion_H
+#define PointerMotion_H
+
+#include "WProgram.h"
+
+// -----------------------------------------------------------------------------
+
+class PointerMotion
+{
+public:
+
+    //- Number of points of the pointer acceleration curve
+    //  at speeds 1, 2, 4 ... 128 counts per accelPeriod_
+    static const uint8_t nAccelPoints_ = 8;
+
+    //- Number of fractional bits of the acceleration gains
+    static const uint8_t accelShift_ = 4;
+
+    //- Number of fractional bits of the per-axis scale
+    static const uint8_t scaleShift_ = 16;
+
+    //- Maximum motion sent per report in each direction
+    static const int16_t maxReport_ = 127;
+
+
+private:
+
+    //- Period over which the acceleration curve speeds are counted [us]
+    //  so that the curve does not depend on the rate of the motion bursts
+    static const uint32_t accelPeriod_ = 1000;
+
+    //- Interval between motion bursts rounded to units of 2^8us to index
+    //  accelRecip_, avoiding a division for each report
+    static const uint8_t accelIntervalShift_ = 8;
+
+    //- Number of intervals in accelRecip_.  The ball was still for part
+    //  of a longer interval, so that the motion covers less time than the
+    //  interval, and the longest is used instead.
+    static const uint8_t nAccelIntervals_ = 32;
+
+    //- Number of fractional bits of accelRecip_
+    static const uint8_t accelRecipShift_ = 12;
+
+    //- accelPeriod_ divided by each rounded interval in units of
+    //  2^-accelRecipShift_, the shortest used for the interval 0
+    static const uint16_t accelRecip_[nAccelIntervals_];
+
+    //- Pointer gain at each point of the acceleration curve in units of
+    //  1/16, interpolated linearly between points and constant beyond
+    uint8_t accelCurve_[nAccelPoints_] = {16, 16, 16, 16, 16, 16, 16, 16};
+
+    //- Scale of the pointer x and y motion in units of 2^-16
+    //  providing any effective resolution independently in x and y
+    uint32_t scale_[2] = {1 << scaleShift_, 1 << scaleShift_};
+
+    //- Remainder of the scaled sensor motion carried to the next burst
+    //  in units of 2^-(scaleShift_ + accelShift_), always positive
+    int32_t remainder_[2] = {0, 0};
+
+
+public:
+
+    // Member functions
+
+        //- Return the gain of point i of the acceleration curve
+        inline uint8_t accelCurve(const uint8_t i) const
+        {
+            return accelCurve_[i];
+        }
+
+        //- Set the gain of point i of the acceleration curve
+        inline void accelCurve(const uint8_t i, const uint8_t gain)
+        {
+            accelCurve_[i] = gain;
+        }
+
+        //- Return the scale of the pointer x (0) or y (1) motion
+        inline uint32_t scale(const uint8_t i) const
+        {
+            return scale_[i];
+        }
+
+        //- Set the scale of the pointer x (0) or y (1) motion
+        inline void scale(const uint8_t i, const uint32_t s)
+        {
+            scale_[i] = s;
+        }
+
+        //- Return the gain from the acceleration curve for the sensor motion
+        //  over the interval [us] in units of 2^-accelShift_
+        int32_t accelGain(const int16_t xy[2], const uint32_t interval) const;
+
+        //- Apply the acceleration gain and per-axis scale to the sensor
+        //  motion over the interval [us] carrying the fractional remainder
+        //  to the next call.  The sensor x and y motion move the pointer in
+        //  y and x and are clipped to +/-maxReport_.
+        void transfer(int16_t xy[2], const uint32_t interval);
+};
+
+
+// -----------------------------------------------------------------------------
+#endif // PointerMotion_H
+// -----------------------------------------------------------------------------
@@ -21,7 +21,8 @@
 
 #include "PowerSave.h"
 #include "EEPROMParameters.h"
-#include "initialize.h"
+#include "usb_dev.h"
+#include "spi4teensy3.h"
 #include "debug.h"
 
 // -----------------------------------------------------------------------------
@@ -43,9 +44,9 @@ void PowerSave::wake()
 }
 
 
-PowerSave::PowerSave(KeyMatrix& km, TrackBall& tb, const ptrdiff_t eepromStart)
+PowerSave::PowerSave(KeyMatrix& km, TrackBall& tb)
 :
-    eepromStart_(eepromStart)
+    eepromStart_(ConfigStore::add(sizeof(parameters)))
 {
     keyMatrixPtr = &km;
     trackBallPtr = &tb;
@@ -55,37 +56,244 @@ PowerSave::PowerSave(KeyMatrix& km, TrackBall& tb, const ptrdiff_t eepromStart)
 void PowerSave::begin()
 {
     pinMode(wakePin_, INPUT_PULLUP);
+    pinMode(keyWakePin_, INPUT_PULLUP);
     configure();
+    lastActive_ = millis();
+    stats_.begin();
 }
 
 
-void PowerSave::sleep()
+void PowerSave::enter(const tier t)
 {
-    idleCount_ = 0;
+    switch (t)
+    {
+        case scanTier:
+            keyMatrixPtr->slowScan(true);
+            break;
 
-    if (trackBallPtr)
+        // Select the idle trackball sensor profile to trade latency for current
+        case restTier:
+            trackBallPtr->idle(true);
+            break;
+
+        case ledTier:
+            keyMatrixPtr->sleep();
+            break;
+
+        // Detect the host resuming the bus without the USB clock, enabled
+        // while the USB registers are still clocked
+        case clockTier:
+            usb_resume_detect(1);
+            cpu(reducedClock_);
+            break;
+    }
+
+    tiers_ |= t;
+    stats_.set(state());
+}
+
+
+void PowerSave::leave()
+{
+    // Restore the clock first for the SPI and I2C, and the USB registers
+    if (tiers_ & clockTier)
     {
-        trackBallPtr->sleep();
+        cpu(F_CPU);
+        usb_resume_detect(0);
     }
 
-    if (keyMatrixPtr)
+    if (tiers_ & ledTier)
     {
-        keyMatrixPtr->sleep();
+        keyMatrixPtr->wake();
     }
 
-    powerControl_.DeepSleep(GPIO_WAKE, wakeGPIOPin_, wake);
+    if (tiers_ & restTier)
+    {
+        trackBallPtr->idle(false);
+    }
+
+    if (tiers_ & scanTier)
+    {
+        keyMatrixPtr->slowScan(false);
+    }
+
+    tiers_ = 0;
+    stats_.set(state());
+}
+
+
+PowerStatistics::state PowerSave::state() const
+{
+    return
+        tiers_ & clockTier ? PowerStatistics::reducedClock
+      : tiers_ & ledTier ? PowerStatistics::ledOff
+      : tiers_ & restTier ? PowerStatistics::sensorRest
+      : tiers_ & scanTier ? PowerStatistics::slowScan
+      : PowerStatistics::active;
+}
+
+
+void PowerSave::cpu(const uint32_t freq)
+{
+    // TEENSY3_LP::CPU() restarts millis()
+    const uint32_t t = idleTime();
+    const uint32_t stateTime = stats_.stateTime();
+
+    // Complete any SPI transfer at the current clock
+    spi4teensy3::dmaWait();
+
+    powerControl_.CPU(freq);
+    lastActive_ = millis() - t;
+    stats_.stateTime(stateTime);
+
+    // Set the SPI and I2C clock dividers for the new bus clock
+    trackBallPtr->spiInit();
+    keyMatrixPtr->clockChanged();
+}
+
+
+uint32_t PowerSave::deepSleep()
+{
+    sleep_block_t config;
+    config.modules = GPIO_WAKE | LPTMR_WAKE;
+    config.gpio_pin = wakeGPIOPin_ | motionGPIOPin_ | keyGPIOPins_;
+    config.callback = wakeISR;
+
+    // Idle time before sleep and the time slept (ms)
+    const uint32_t t = idleTime();
+    uint32_t slept = 0;
+    const uint32_t hibernateTime = uint32_t(hibernateTimeout_)*1000;
+
+    while (true)
+    {
+        uint32_t tick = sleepTick_;
+
+        if (hibernateTimeout_)
+        {
+            if (t + slept >= hibernateTime)
+            {
+                // Does not return, wakes by reset
+                config.modules = GPIO_WAKE;
+                powerControl_.Hibernate(&config);
+            }
+
+            const uint32_t remaining = hibernateTime - t - slept;
+            if (remaining < tick)
+            {
+                tick = remaining;
+            }
+        }
+
+        config.lptmr_timeout = tick;
+        powerControl_.DeepSleep(&config);
+
+        if (config.wake_source != LPTMR_WAKE)
+        {
+            // The time into the last tick is not known so count half
+            slept += tick/2;
+            wakeSource_ = config.wake_source;
+            break;
+        }
+
+        slept += tick;
+    }
+
+    return slept;
+}
+
+
+void PowerSave::sleep()
+{
+    leave();
+
+    // Leave the trackball sensor resting and all the rows driven
+    // so that motion or a key press wakes.  The rows drive the IR LEDs
+    // which stay lit, the cost of which is in the deepSleep current.
+    trackBallPtr->rest();
+    keyMatrixPtr->sleep();
+    keyMatrixPtr->wakeOnKey(true);
+
+    // Write any configuration changes staged which hibernation would lose
+    ConfigStore::commit();
+
+    stats_.set(PowerStatistics::deepSleep);
+    const uint32_t slept = deepSleep();
+
+    keyMatrixPtr->wakeOnKey(false);
+    wake();
+
+    // The SysTick is stopped in deep sleep so restart the idle time on wake
+    lastActive_ = millis();
+    stats_.woken
+    (
+        slept,
+        wakeSource_ == wakeGPIOPin_ ? PowerStatistics::switchWake
+      : wakeSource_ == motionGPIOPin_ ? PowerStatistics::motionWake
+      : wakeSource_ & keyGPIOPins_ ? PowerStatistics::keyWake
+      : PowerStatistics::otherWake
+    );
+    wakeTime_ = micros();
+    wakePending_ = true;
 }
 
 
 void PowerSave::configure()
 {
-    if (initialize)
+    // Load the parameters stored over the defaults
+    parameters p;
+    memset(&p, 0, sizeof(p));
+    p.timeout = timeout_;
+    p.idleTimeout = idleTimeout_;
+    p.scanTimeout = scanTimeout_;
+    p.ledTimeout = ledTimeout_;
+    p.clockTimeout = clockTimeout_;
+    p.hibernateTimeout = hibernateTimeout_;
+
+    for (uint8_t i=0; i<PowerStatistics::nStates; i++)
     {
-        eepromSet(timeout, timeout_);
+        p.current[i] = stats_.current(i);
+    }
+    p.currentMeasured = stats_.measured();
+
+    ConfigStore::load(eepromStart_, &p, sizeof(p));
+
+    timeout_ = p.timeout;
+    idleTimeout_ = p.idleTimeout;
+    scanTimeout_ = p.scanTimeout;
+    ledTimeout_ = p.ledTimeout;
+    clockTimeout_ = p.clockTimeout;
+    hibernateTimeout_ = p.hibernateTimeout;
+
+    for (uint8_t i=0; i<PowerStatistics::nStates; i++)
+    {
+        stats_.current(i, p.current[i]);
+    }
+    stats_.measured(p.currentMeasured);
+}
+
+
+void PowerSave::current(const uint32_t value)
+{
+    const uint8_t s = value >> 16;
+
+    if (s < PowerStatistics::nStates)
+    {
+        stats_.current(s, value & 0xffff);
+        eepromStore(PROP_ADDR(current) + 2*s, stats_.current(s));
+
+        // The current set replaces the placeholder default
+        stats_.measured(stats_.measured() | (1 << s));
+        eepromSet(currentMeasured, stats_.measured());
+
+        Serial.print("TrackHand: setting current ");
+        Serial.print(s);
+        Serial.print(" to ");
+        Serial.print(stats_.current(s));
+        Serial.println(" successful");
     }
     else
     {
-        timeout_ = eepromGet(timeout);
+        ConfigProtocol::fail();
     }
 }
 
@@ -95,13 +303,75 @@ bool PowerSave::configure(const char cmd)
     switch (cmd)
     {
         case 't':
-            eepromSetFromSerial(cmd, timeout);
+            eepromSetFromFrame(timeout);
             timeout_ = eepromGet(timeout);
             return true;
             break;
+        case 'i':
+            eepromSetFromFrame(idleTimeout);
+            idleTimeout_ = eepromGet(idleTimeout);
+            return true;
+            break;
+        case 'S':
+            eepromSetFromFrame(scanTimeout);
+            scanTimeout_ = eepromGet(scanTimeout);
+            return true;
+            break;
+        case 'L':
+            eepromSetFromFrame(ledTimeout);
+            ledTimeout_ = eepromGet(ledTimeout);
+            return true;
+            break;
+        case 'C':
+            eepromSetFromFrame(clockTimeout);
+            clockTimeout_ = eepromGet(clockTimeout);
+            return true;
+            break;
+        case 'H':
+            eepromSetFromFrame(hibernateTimeout);
+            hibernateTimeout_ = eepromGet(hibernateTimeout);
+            return true;
+            break;
+        case 'I':
+            {
+                // Set the current of a power state
+                // sent as (state << 16) | current
+                uint32_t value;
+                if (readValue("current", value))
+                {
+                    current(value);
+                }
+            }
+            return true;
+            break;
+        case 'e':
+            stats_.print();
+            return true;
+            break;
         case 'p':
             Serial.print("PowerSave timeout ");
             Serial.println(timeout_);
+            Serial.print("PowerSave idleTimeout ");
+            Serial.println(idleTimeout_);
+            Serial.print("PowerSave scanTimeout ");
+            Serial.println(scanTimeout_);
+            Serial.print("PowerSave ledTimeout ");
+            Serial.println(ledTimeout_);
+            Serial.print("PowerSave clockTimeout ");
+            Serial.println(clockTimeout_);
+            Serial.print("PowerSave hibernateTimeout ");
+            Serial.println(hibernateTimeout_);
+            Serial.print("PowerSave wake source ");
+            Serial.print
+            (
+                wakeSource_ == wakeGPIOPin_ ? "switch"
+              : wakeSource_ == motionGPIOPin_ ? "trackball"
+              : wakeSource_ & keyGPIOPins_ ? "key"
+              : "none"
+            );
+            Serial.print(" latency ");
+            Serial.print(wakeLatency_);
+            Serial.println("us");
             return true;
             break;
     }
@@ -114,14 +384,64 @@ void PowerSave::operator()(const bool changed)
 {
     if (changed)
     {
-        idleCount_ = 0;
+        lastActive_ = millis();
+
+        if (wakePending_)
+        {
+            wakeLatency_ = micros() - wakeTime_;
+            wakePending_ = false;
+        }
+
+        if (tiers_)
+        {
+            leave();
+        }
+
+        return;
     }
-    else
+
+    // Restore the clock when the host resumes the bus so that the USB module
+    // can respond, keeping the other tiers which are independent of the bus
+    if ((tiers_ & clockTier) && usb_resumed)
+    {
+        cpu(F_CPU);
+        usb_resume_detect(0);
+        tiers_ &= ~clockTier;
+        stats_.set(state());
+        resumeTime_ = millis();
+    }
+
+    const uint32_t t = idleTime();
+
+    if (!(tiers_ & scanTier) && expired(scanTimeout_, t))
+    {
+        enter(scanTier);
+    }
+
+    if (!(tiers_ & restTier) && expired(idleTimeout_, t))
+    {
+        enter(restTier);
+    }
+
+    if (!(tiers_ & ledTier) && expired(ledTimeout_, t))
+    {
+        enter(ledTier);
+    }
+
+    // The reduced clock stops the USB module
+    // so only while the host has suspended the bus
+    if
+    (
+        !(tiers_ & clockTier)
+     && expired(clockTimeout_, t)
+     && micros() - usb_sof_time > 3000
+     && millis() - resumeTime_ > resumeWait_
+    )
     {
-        idleCount_++;
+        enter(clockTier);
     }
 
-    if (idleCount_ > timeout_*1000/iterTime_)
+    if (expired(timeout_, t))
     {
         sleep();
     }
@@ -20,9 +20,32 @@
 // -----------------------------------------------------------------------------
 /// Title: Power management class
 ///  Description:
-//    Handles idle-time counting, sleep and wake-up of the KeyMatrix and
-//    TrackBall.  Wake-up is achieved by setting wakePin_ high using a physical
-//    switch.
+//    Handles idle-time tracking from millis(), sleep and wake-up of the
+//    KeyMatrix and TrackBall.  Deep sleep is woken through the LLWU by the
+//    physical switch on wakePin_, trackball motion with the sensor resting
+//    rather than shut down, or any key press with all the rows driven: the
+//    right-hand column 1 directly and column 0 by a diode wired-OR with the
+//    open-drain left-hand MCP23018 INT on keyWakePin_.  The wake-up source
+//    and the time from wake-up to the first key press or motion reported are
+//    recorded.
+//
+//    As the idle time increases a ladder of power-saving tiers is entered
+//    in turn, each after its own timeout stored in EEPROM, 0 disabling it:
+//    slow scanning, the idle trackball sensor profile, mode LED off, reduced
+//    CPU clock, deep sleep and hibernation.  All the tiers up to deep sleep
+//    are left immediately on key press or trackball motion.
+//
+//    TEENSY3_LP::CPU() stops the USB module below 24MHz so the reduced clock
+//    is only selected while the host has suspended the bus, i.e. there are
+//    no USB start-of-frames, and is left when the host resumes the bus,
+//    detected by the USB asynchronous resume interrupt without accessing the
+//    USB registers until the clock is restored.  Hibernation is entered from
+//    deep sleep, the time spent in which is counted by periodic LPTMR
+//    wake-ups, and wakes by reset.
+//
+//    The time in and entries to each power state, the wake-ups by each source
+//    and the estimated mean current from a table of the current in each state
+//    stored in EEPROM are kept by PowerStatistics.
 // -----------------------------------------------------------------------------
 
 #ifndef PowerSave_H
@@ -30,6 +53,7 @@
 
 #include "KeyMatrix.h"
 #include "TrackBall.h"
+#include "PowerStatistics.h"
 #include <LowPower_Teensy3.h>
 
 // -----------------------------------------------------------------------------
@@ -44,40 +68,147 @@ class PowerSave
         //- Pin used to wake from power-saving sleep
         const uint8_t wakeGPIOPin_ = PIN_33;
 
+        //- Pin of the wired-OR of the right-hand column 0
+        //  and the left-hand MCP23018 INT
+        const uint8_t keyWakePin_ = 4;
+
+        //- Pins used to wake from deep sleep by a key press
+        //  the right-hand column 1 and keyWakePin_
+        const uint16_t keyGPIOPins_ = PIN_16 | PIN_4;
+
+        //- Pin used to wake from deep sleep by trackball motion, MOT
+        const uint16_t motionGPIOPin_ = PIN_9;
+
+        //- Source of the last wake-up from deep sleep
+        uint32_t wakeSource_ = 0;
+
+        //- Time of the last wake-up from deep sleep (us)
+        uint32_t wakeTime_ = 0;
+
+        //- Set until the first key press or motion after wake-up
+        bool wakePending_ = false;
+
+        //- Time from the last wake-up to the first key press or motion (us)
+        uint32_t wakeLatency_ = 0;
+
         //- Static pointer to the keyMatrix needed by the restart() callback
         static KeyMatrix* keyMatrixPtr;
 
         //- Static pointer to the trackBall needed by the restart() callback
         static TrackBall* trackBallPtr;
 
-        //- Timeout (s)
+        //- Timeout after which deep sleep is entered (s)
         uint16_t timeout_ = 1200;
 
-        //- Iteration time (ms)
-        const uint16_t iterTime_ = 30;
+        //- Timeout after which the idle trackball sensor profile is selected (s)
+        uint16_t idleTimeout_ = 10;
+
+        //- Timeout after which the keys are scanned slowly (s)
+        uint16_t scanTimeout_ = 2;
+
+        //- Timeout after which the mode LED is switched off (s)
+        uint16_t ledTimeout_ = 60;
+
+        //- Timeout after which the CPU clock is reduced
+        //  if the USB bus is suspended (s)
+        uint16_t clockTimeout_ = 30;
+
+        //- Timeout after which deep sleep is changed to hibernation (s)
+        uint16_t hibernateTimeout_ = 0;
+
+        //- Power-saving tiers, entered in turn, left on activity
+        enum tier
+        {
+            scanTier = 1,
+            restTier = 2,
+            ledTier = 4,
+            clockTier = 8
+        };
+
+        //- Tiers currently entered
+        uint8_t tiers_ = 0;
+
+        //- Reduced CPU clock (Hz)
+        const uint32_t reducedClock_ = EIGHT_MHZ;
+
+        //- Time allowed after the host resumes the bus for the
+        //  start-of-frames to restart before the clock may be reduced (ms)
+        const uint16_t resumeWait_ = 100;
+
+        //- Time the host last resumed the bus while the clock was reduced (ms)
+        uint32_t resumeTime_ = 0;
+
+        //- Deep sleep between LPTMR wake-ups to count the time asleep (ms)
+        const uint16_t sleepTick_ = 10000;
+
+        //- Power-state residency and energy statistics
+        PowerStatistics stats_;
 
         //- Power controller
         TEENSY3_LP powerControl_;
 
-        //- Time counter
-        uint32_t idleCount_ = 0;
+        //- Time of the last key press or trackball motion (ms)
+        uint32_t lastActive_ = 0;
 
         static void wake();
 
-        //- Structure representing the storage of the parameters in EEPROM
+        //- Deep-sleep wake-up callback, the KeyMatrix and TrackBall are woken
+        //  on return if the wake-up was not from the LPTMR
+        static void wakeISR()
+        {}
+
+        //- Structure representing the storage of the parameters in the
+        //  ConfigStore, fields may only be appended
         struct parameters
         {
             uint16_t timeout;
+            uint16_t idleTimeout;
+            uint16_t scanTimeout;
+            uint16_t ledTimeout;
+            uint16_t clockTimeout;
+            uint16_t hibernateTimeout;
+            uint16_t current[PowerStatistics::nStates];
+            uint8_t currentMeasured;
         };
 
-        //- Start of the EEPROM storage for the configuration parameters
+        //- Offset of the configuration parameters in the ConfigStore
         ptrdiff_t eepromStart_;
 
 
+    // Private member functions
+
+        //- Return true if the idle time t (ms) exceeds the timeout (s)
+        //  which is not 0
+        static bool expired(const uint16_t timeout, const uint32_t t)
+        {
+            return timeout && t > uint32_t(timeout)*1000;
+        }
+
+        //- Enter the tier
+        void enter(const tier t);
+
+        //- Leave all the tiers entered
+        void leave();
+
+        //- Return the power state, the deepest tier entered
+        PowerStatistics::state state() const;
+
+        //- Set the CPU clock keeping the idle and power-state times
+        void cpu(const uint32_t freq);
+
+        //- Deep sleep until woken by the wake pins, or hibernate after
+        //  hibernateTimeout_ if set, returning the time slept (ms)
+        uint32_t deepSleep();
+
+        //- Set the current drawn in a power state sent as (state << 16) | current
+        //  in units of 10uA and save it in EEPROM
+        void current(const uint32_t value);
+
+
 public:
 
     //- Constructor
-    PowerSave(KeyMatrix& km, TrackBall& tb, const ptrdiff_t eepromStart);
+    PowerSave(KeyMatrix& km, TrackBall& tb);
 
 
     // Member functions
@@ -94,7 +225,13 @@ public:
         //- Configure parameters stored in EEPROM from Serial
         bool configure(const char cmd);
 
-        //- Check if anything has changed and reset sleep counter
+        //- Return the time since the last key press or trackball motion (ms)
+        uint32_t idleTime() const
+        {
+            return millis() - lastActive_;
+        }
+
+        //- Check if anything has changed and reset the idle time
         void operator()(const bool changed);
 };
 
@@ -0,0 +1,165 @@
+/// Copyright 2014 Henry G. Weller
+// -----------------------------------------------------------------------------
+//  This file is part of
+/// ---     TrackHand: DataHand with Laser TrackBall
+// -----------------------------------------------------------------------------
+//
+//  TrackHand is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  TrackHand is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+//  for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with TrackHand.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+
+#include "PowerStatistics.h"
+
+// -----------------------------------------------------------------------------
+
+const char* PowerStatistics::stateNames_[PowerStatistics::nStates] =
+{
+    "active",
+    "slowScan",
+    "sensorRest",
+    "ledOff",
+    "reducedClock",
+    "deepSleep"
+};
+
+
+const char* PowerStatistics::wakeSourceNames_[PowerStatistics::nWakeSources] =
+{
+    "switch",
+    "trackball",
+    "key",
+    "other"
+};
+
+
+// -----------------------------------------------------------------------------
+
+void PowerStatistics::add(const state s, const uint32_t t)
+{
+    const uint32_t ms = ms_[s] + t;
+    seconds_[s] += ms/1000;
+    ms_[s] = ms % 1000;
+}
+
+
+void PowerStatistics::printCurrent(const uint32_t current)
+{
+    Serial.print(current/100);
+    Serial.print('.');
+    if (current % 100 < 10)
+    {
+        Serial.print('0');
+    }
+    Serial.print(current % 100);
+    Serial.print("mA");
+}
+
+
+void PowerStatistics::begin()
+{
+    state_ = active;
+    start_ = millis();
+    entries_[active]++;
+}
+
+
+void PowerStatistics::set(const state s)
+{
+    if (s != state_)
+    {
+        const uint32_t now = millis();
+        add(state_, now - start_);
+        state_ = s;
+        start_ = now;
+        entries_[s]++;
+    }
+}
+
+
+void PowerStatistics::woken(const uint32_t t, const wakeSource source)
+{
+    add(deepSleep, t);
+    wakes_[source]++;
+
+    state_ = active;
+    start_ = millis();
+    entries_[active]++;
+}
+
+
+void PowerStatistics::print() const
+{
+    double total = 0;
+    double charge = 0;
+    bool placeholder = false;
+
+    for (uint8_t s=0; s<nStates; s++)
+    {
+        double t = seconds_[s] + ms_[s]/1000.0;
+
+        // Include the time in the current state so far
+        if (s == state_)
+        {
+            t += stateTime()/1000.0;
+        }
+
+        total += t;
+        charge += t*current_[s];
+
+        const bool measured = measured_ & (1 << s);
+        placeholder = placeholder || (t > 0 && !measured);
+
+        Serial.print("PowerSave ");
+        Serial.print(stateNames_[s]);
+        Serial.print(' ');
+        Serial.print(t, 1);
+        Serial.print("s entries ");
+        Serial.print(entries_[s]);
+        Serial.print(" current ");
+        printCurrent(current_[s]);
+        if (!measured)
+        {
+            Serial.print(" placeholder");
+        }
+        if (s == deepSleep)
+        {
+            Serial.print(" including the IR LEDs lit to wake by key");
+        }
+        Serial.println();
+    }
+
+    Serial.print("PowerSave wakes");
+    for (uint8_t w=0; w<nWakeSources; w++)
+    {
+        Serial.print(' ');
+        Serial.print(wakeSourceNames_[w]);
+        Serial.print(' ');
+        Serial.print(wakes_[w]);
+    }
+    Serial.println();
+
+    Serial.print("PowerSave mean current ");
+    printCurrent(total > 0 ? uint32_t(charge/total + 0.5) : 0);
+    Serial.print(" charge ");
+    Serial.print(charge/3600/100, 2);
+    Serial.print("mAh");
+    if (placeholder)
+    {
+        Serial.print(" estimated from placeholder currents");
+    }
+    Serial.println();
+}
+
+
+// -----------------------------------------------------------------------------
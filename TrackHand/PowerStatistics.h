@@ -0,0 +1,174 @@
+/// Copyright 2014 Henry G. Weller
+// -----------------------------------------------------------------------------
+//  This file is part of
+/// ---     TrackHand: DataHand with Laser TrackBall
+// -----------------------------------------------------------------------------
+//
+//  TrackHand is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  TrackHand is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+//  for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with TrackHand.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+/// Title: Power-state residency and energy statistics
+///  Description:
+//    Counts the time spent in and the number of entries to each power state
+//    of PowerSave, the number of wake-ups from deep sleep by each source and
+//    estimates the mean current from the time in each state and a table of
+//    the current drawn in each, stored in EEPROM by PowerSave.  Until the
+//    current of a state is measured and set the default is a placeholder,
+//    which is marked in the output.
+//
+//    The time in deep sleep, during which millis() is stopped, is counted by
+//    PowerSave from the LPTMR wake-ups.
+//
+//    The matrix rows drive the IR LEDs of the optical switches, so the rows
+//    driven through deep sleep to wake on a key press keep all the IR LEDs
+//    lit.  They cannot be switched off separately, and their current is
+//    expected to dominate the deepSleep entry of the table.  It is printed
+//    with that state as the cost of waking by key.
+// -----------------------------------------------------------------------------
+
+#ifndef PowerStatistics_H
+#define PowerStatistics_H
+
+#include "WProgram.h"
+
+// -----------------------------------------------------------------------------
+
+class PowerStatistics
+{
+public:
+
+    //- Power states, the deepest power-saving tier entered
+    enum state
+    {
+        active,
+        slowScan,
+        sensorRest,
+        ledOff,
+        reducedClock,
+        deepSleep,
+        nStates
+    };
+
+    //- Sources of wake-up from deep sleep
+    enum wakeSource
+    {
+        switchWake,
+        motionWake,
+        keyWake,
+        otherWake,
+        nWakeSources
+    };
+
+
+private:
+
+    //- Names of the power states
+    static const char* stateNames_[nStates];
+
+    //- Names of the wake-up sources
+    static const char* wakeSourceNames_[nWakeSources];
+
+    //- Current state and the time it was entered (ms)
+    state state_ = active;
+    uint32_t start_ = 0;
+
+    //- Time in each state, whole seconds and the remaining ms
+    uint32_t seconds_[nStates] = {0};
+    uint16_t ms_[nStates] = {0};
+
+    //- Number of entries to each state
+    uint32_t entries_[nStates] = {0};
+
+    //- Number of wake-ups from deep sleep by each source
+    uint32_t wakes_[nWakeSources] = {0};
+
+    //- Current drawn in each state (10uA), rough estimates to be replaced
+    //  by measurements.  That in deepSleep includes the IR LEDs lit by the
+    //  rows driven to wake on a key press.
+    uint16_t current_[nStates] = {8000, 7000, 5000, 4800, 3000, 1500};
+
+    //- Bit set for each state the current of which has been measured,
+    //  i.e. set rather than the placeholder default
+    uint8_t measured_ = 0;
+
+    //- Add the time (ms) to the state
+    void add(const state s, const uint32_t t);
+
+    //- Print the current (10uA) in mA
+    static void printCurrent(const uint32_t current);
+
+
+public:
+
+    // Member functions
+
+        //- Start counting in the active state
+        void begin();
+
+        //- Change to the state if different
+        void set(const state s);
+
+        //- Return the time in the current state (ms)
+        uint32_t stateTime() const
+        {
+            return millis() - start_;
+        }
+
+        //- Set the time in the current state (ms),
+        //  e.g. after millis() is restarted by a change of CPU clock
+        void stateTime(const uint32_t t)
+        {
+            start_ = millis() - t;
+        }
+
+        //- Add the time slept (ms) to deep sleep and change to the active
+        //  state on wake-up from the source
+        void woken(const uint32_t t, const wakeSource source);
+
+        //- Return the current drawn in the state (10uA)
+        uint16_t current(const uint8_t s) const
+        {
+            return current_[s];
+        }
+
+        //- Set the current drawn in the state (10uA)
+        void current(const uint8_t s, const uint16_t current)
+        {
+            if (s < nStates)
+            {
+                current_[s] = current;
+            }
+        }
+
+        //- Return the bits set for the states with measured currents
+        uint8_t measured() const
+        {
+            return measured_;
+        }
+
+        //- Set the bits for the states with measured currents
+        void measured(const uint8_t mask)
+        {
+            measured_ = mask;
+        }
+
+        //- Print the statistics on Serial, marking the currents and the
+        //  mean current estimated from the placeholder defaults
+        void print() const;
+};
+
+
+// -----------------------------------------------------------------------------
+#endif // PowerStatistics_H
+// -----------------------------------------------------------------------------
@@ -0,0 +1,79 @@
+/// Copyright 2014 Henry G. Weller
+// -----------------------------------------------------------------------------
+//  This file is part of
+/// ---     TrackHand: DataHand with Laser TrackBall
+// -----------------------------------------------------------------------------
+//
+//  TrackHand is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  TrackHand is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+//  for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with TrackHand.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+
+#include "SensorHealth.h"
+
+// -----------------------------------------------------------------------------
+
+void SensorHealth::update(const ADNS9800::burstData& data)
+{
+    nBursts_++;
+
+    if (data.motion & MOTION_LIFT)
+    {
+        nLifts_++;
+    }
+
+    if (data.motion & MOTION_Fault)
+    {
+        nFaults_++;
+    }
+
+    average(squal_, data.squal);
+    average(pixelSum_, data.pixelSum);
+    average(shutter_, data.shutter);
+    average(framePeriod_, data.framePeriod);
+
+    if (data.squal < squalMin_)
+    {
+        squalMin_ = data.squal;
+    }
+}
+
+
+void SensorHealth::print()
+{
+    Serial.print("TrackBall SQUAL average ");
+    Serial.print(squal_ >> avgShift_);
+    Serial.print(" min ");
+    Serial.println(squalMin_);
+
+    Serial.print("TrackBall pixel sum average ");
+    Serial.println(pixelSum_ >> avgShift_);
+
+    Serial.print("TrackBall shutter average ");
+    Serial.println(shutter_ >> avgShift_);
+
+    Serial.print("TrackBall frame period average ");
+    Serial.println(framePeriod_ >> avgShift_);
+
+    Serial.print("TrackBall bursts ");
+    Serial.print(nBursts_);
+    Serial.print(" lifted ");
+    Serial.print(nLifts_);
+    Serial.print(" faults ");
+    Serial.println(nFaults_);
+
+    squalMin_ = UINT8_MAX;
+}
+
+
+// -----------------------------------------------------------------------------
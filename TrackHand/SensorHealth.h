@@ -0,0 +1,90 @@
+/// Copyright 2014 Henry G. Weller
+// -----------------------------------------------------------------------------
+//  This file is part of
+/// ---     TrackHand: DataHand with Laser TrackBall
+// -----------------------------------------------------------------------------
+//
+//  TrackHand is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  TrackHand is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+//  for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with TrackHand.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+/// Title: ADNS-9800 sensor-health statistics
+///  Description:
+//    Rolling averages of the surface quality, pixel sum, shutter and frame
+//    period reported by the motion burst together with the minimum surface
+//    quality and the number of lift and laser-fault reports, used to detect
+//    a dirty ball or degraded lens.
+// -----------------------------------------------------------------------------
+
+#ifndef SensorHealth_H
+#define SensorHealth_H
+
+#include "WProgram.h"
+#include "ADNS9800.h"
+
+// -----------------------------------------------------------------------------
+
+class SensorHealth
+{
+    //- Number of bits the averages are shifted by,
+    //  each average includes approximately the last 2^avgShift_ bursts
+    static const uint8_t avgShift_ = 4;
+
+    //- Rolling averages scaled by 2^avgShift_
+    uint32_t squal_ = 0;
+    uint32_t pixelSum_ = 0;
+    uint32_t shutter_ = 0;
+    uint32_t framePeriod_ = 0;
+
+    //- Minimum surface quality since the statistics were last printed
+    uint8_t squalMin_ = UINT8_MAX;
+
+    //- Number of motion bursts read
+    uint32_t nBursts_ = 0;
+
+    //- Number of motion bursts with the LIFT bit set
+    uint32_t nLifts_ = 0;
+
+    //- Number of motion bursts with the laser Fault bit set
+    uint32_t nFaults_ = 0;
+
+    //- Update the rolling average avg with the value
+    inline void average(uint32_t& avg, const uint16_t value)
+    {
+        if (nBursts_ == 1)
+        {
+            avg = uint32_t(value) << avgShift_;
+        }
+        else
+        {
+            avg += value;
+            avg -= avg >> avgShift_;
+        }
+    }
+
+
+public:
+
+    // Member functions
+
+        //- Update the statistics from the motion burst
+        void update(const ADNS9800::burstData& data);
+
+        //- Print the statistics on Serial and reset the minimum
+        void print();
+};
+
+
+// -----------------------------------------------------------------------------
+#endif // SensorHealth_H
+// -----------------------------------------------------------------------------
@@ -22,27 +22,53 @@
 #include "TrackBall.h"
 #include <spi4teensy3.h>
 #include "EEPROMParameters.h"
-#include "initialize.h"
 #include "debug.h"
 
 // -----------------------------------------------------------------------------
 
 void TrackBall::configure()
 {
-    if (initialize)
+    // Load the parameters stored over the defaults
+    parameters p;
+    memset(&p, 0, sizeof(p));
+    p.resolution = resolution_;
+    p.scrollDivider = scrollDivider_;
+    for (uint8_t i=0; i<nAccelPoints_; i++)
     {
-        eepromSet(resolution, resolution_);
-        eepromSet(scrollDivider, scrollDivider_);
+        p.accelCurve[i] = pointer_.accelCurve(i);
     }
-    else
+    p.scaleX = pointer_.scale(0);
+    p.scaleY = pointer_.scale(1);
+    p.sensorProfile = sensorProfile_;
+    p.idleSensorProfile = idleSensorProfile_;
+
+    ConfigStore::load(eepromStart_, &p, sizeof(p));
+
+    resolution_ = p.resolution;
+
+    // A zero scroll divider, e.g. set by a set frame, keeps the previous
+    if (p.scrollDivider)
     {
-        // Update the movement resolution and scroll-divider
-        // from the values stored in EEPROM
-        resolution_ = eepromGet(resolution);
-        scrollDivider_ = eepromGet(scrollDivider);
+        scrollDivider_ = p.scrollDivider;
     }
 
+    for (uint8_t i=0; i<nAccelPoints_; i++)
+    {
+        pointer_.accelCurve(i, p.accelCurve[i]);
+    }
+    pointer_.scale(0, p.scaleX);
+    pointer_.scale(1, p.scaleY);
+    sensorProfile_ = p.sensorProfile % nProfiles;
+    idleSensorProfile_ = p.idleSensorProfile % nProfiles;
+
     setResolution(resolution_);
+
+    #ifdef SCROLLBALL
+    scrollBall_.setResolution(resolution_);
+    #endif
+
+    // Keep the idle profile if the profile is changed while idle
+    selectProfile();
 }
 
 
@@ -51,14 +77,67 @@ bool TrackBall::configure(const char cmd)
     switch (cmd)
     {
         case 'r':
-            eepromSetFromSerial(cmd, resolution);
+            eepromSetFromFrame(resolution);
             resolution_ = eepromGet(resolution);
             setResolution(resolution_);
+            #ifdef SCROLLBALL
+            scrollBall_.setResolution(resolution_);
+            #endif
             return true;
             break;
         case 's':
-            eepromSetFromSerial(cmd, scrollDivider);
-            scrollDivider_ = eepromGet(scrollDivider);
+            {
+                uint8_t value;
+                if (readValue("scrollDivider", value))
+                {
+                    scrollDivider(value);
+                }
+            }
+            return true;
+            break;
+        case 'a':
+            {
+                // Set one point of the acceleration curve
+                // sent as (index << 8) | gain
+                uint16_t value;
+                if (readValue("accelCurve", value))
+                {
+                    accelCurve(value >> 8, value & 0xff);
+                }
+            }
+            return true;
+            break;
+        case 'x':
+            eepromSetFromFrame(scaleX);
+            pointer_.scale(0, eepromGet(scaleX));
+            return true;
+            break;
+        case 'y':
+            eepromSetFromFrame(scaleY);
+            pointer_.scale(1, eepromGet(scaleY));
+            return true;
+            break;
+        case 'f':
+            eepromSetFromFrame(sensorProfile);
+            sensorProfile_ = eepromGet(sensorProfile) % nProfiles;
+            selectProfile();
+            return true;
+            break;
+        case 'F':
+            eepromSetFromFrame(idleSensorProfile);
+            idleSensorProfile_ = eepromGet(idleSensorProfile) % nProfiles;
+            selectProfile();
+            return true;
+            break;
+        case 'c':
+            {
+                // Capture the number of pixel frames requested
+                uint8_t n;
+                if (readValue("capture", n))
+                {
+                    captureFrames(n);
+                }
+            }
             return true;
             break;
         case 'p':
@@ -66,6 +145,25 @@ bool TrackBall::configure(const char cmd)
             Serial.println(eepromGet(resolution));
             Serial.print("TrackBall scrollDivider ");
             Serial.println(scrollDivider_);
+            Serial.print("TrackBall sensorProfile ");
+            Serial.println(profile(sensorProfile_).name);
+            Serial.print("TrackBall idleSensorProfile ");
+            Serial.println(profile(idleSensorProfile_).name);
+            Serial.print("TrackBall scaleX ");
+            Serial.println(pointer_.scale(0));
+            Serial.print("TrackBall scaleY ");
+            Serial.println(pointer_.scale(1));
+            Serial.print("TrackBall accelCurve");
+            for (uint8_t i=0; i<nAccelPoints_; i++)
+            {
+                Serial.print(' ');
+                Serial.print(pointer_.accelCurve(i));
+            }
+            Serial.println();
+            return true;
+            break;
+        case 'q':
+            health_.print();
             return true;
             break;
     }
@@ -79,41 +177,183 @@ void TrackBall::resolution(const uint8_t res)
     resolution_ = res;
     eepromSet(resolution, resolution_);
     setResolution(resolution_);
+
+    #ifdef SCROLLBALL
+    scrollBall_.setResolution(resolution_);
+    #endif
 }
 
 
 void TrackBall::scrollDivider(const uint8_t sdiv)
 {
+    // The scroll motion is divided by the divider so it cannot be zero
+    if (sdiv == 0)
+    {
+        Serial.println("TrackHand: setting scrollDivider to 0 failed");
+        ConfigProtocol::fail();
+        return;
+    }
+
     scrollDivider_ = sdiv;
     eepromSet(scrollDivider, scrollDivider_);
+
+    Serial.print("TrackHand: setting scrollDivider to ");
+    Serial.print(sdiv);
+    Serial.println(" successful");
+}
+
+
+void TrackBall::accelCurve(const uint8_t i, const uint8_t gain)
+{
+    if (i < nAccelPoints_)
+    {
+        pointer_.accelCurve(i, gain);
+        eepromStore(PROP_ADDR(accelCurve) + i, gain);
+
+        Serial.print("TrackHand: setting accelCurve ");
+        Serial.print(i);
+        Serial.print(" to ");
+        Serial.print(gain);
+        Serial.println(" successful");
+    }
+}
+
+
+void TrackBall::captureFrames(const uint8_t n)
+{
+    uint8_t frame[framePixels_];
+    const uint8_t header[4] = {'P', 'X', frameSize_, frameSize_};
+
+    // The sensor is reset once after the last frame rather than after each
+    for (uint8_t i=0; i<n; i++)
+    {
+        if (!captureFrame(frame))
+        {
+            Serial.println("TrackBall: frame capture failed");
+            break;
+        }
+
+        // Send the frame as a whole rather than pixel by pixel
+        Serial.write(header, sizeof(header));
+        Serial.write(frame, framePixels_);
+    }
+
+    // Resume navigation when the wake sequence continued by readMotion()
+    // completes
+    captureEnd();
+
+    Serial.send_now();
+}
+
+
+void TrackBall::selectProfile()
+{
+    const sensorProfile& p =
+        profile(idle_ ? idleSensorProfile_ : sensorProfile_);
+
+    setProfile(p);
+
+    #ifdef SCROLLBALL
+    scrollBall_.setProfile(p);
+    #endif
+}
+
+
+void TrackBall::idle(const bool idle)
+{
+    idle_ = idle;
+    selectProfile();
 }
 
 
-TrackBall::TrackBall(const ptrdiff_t eepromStart)
+TrackBall::TrackBall()
 :
-    eepromStart_(eepromStart)
+    #ifdef SCROLLBALL
+    scrollBall_(SCROLLBALL_NCS, SCROLLBALL_MOT),
+    #endif
+    eepromStart_(ConfigStore::add(sizeof(parameters)))
 {}
 
 
 void TrackBall::begin()
 {
     ADNS9800::begin();
+
+    #ifdef SCROLLBALL
+    scrollBall_.begin();
+    #endif
+
     configure();
 }
 
 
+void TrackBall::sleep()
+{
+    // Shut down the scroll ball while the SPI clock is still running
+    #ifdef SCROLLBALL
+    scrollBall_.sleep();
+    #endif
+
+    ADNS9800::sleep();
+}
+
+
+void TrackBall::rest()
+{
+    // The scroll ball motion pin is not a wake-up source so shut it down
+    #ifdef SCROLLBALL
+    scrollBall_.sleep();
+    #endif
+
+    ADNS9800::rest();
+}
+
+
 void TrackBall::wake()
 {
-    ADNS9800::wake();
-    configure();
+    // A resting sensor is still awake and only its profile is restored
+    if (ready())
+    {
+        setProfile(profile(sensorProfile_));
+    }
+    else
+    {
+        ADNS9800::wake();
+        wakeScreen_ = true;
+    }
+
+    #ifdef SCROLLBALL
+    if (scrollBall_.ready())
+    {
+        scrollBall_.setProfile(profile(sensorProfile_));
+    }
+    else
+    {
+        scrollBall_.wake();
+    }
+    #endif
+}
 
-    // Wait for the ADNS9800 to wake
-    delay(1000);
 
-    // "Wiggle" the pointer a little to wake the screen
-    Mouse.move(1, 0);
-    delay(100);
-    Mouse.move(-1, 0);
+void TrackBall::readMotion()
+{
+    if (wakeStep() && wakeScreen_)
+    {
+        // "Wiggle" the pointer a little to wake the screen
+        Mouse.move(1, 0);
+        Mouse.move(-1, 0);
+        wakeScreen_ = false;
+    }
+
+    adnsBurstMotionStart();
+
+    // The scroll ball burst starts on a later call if that of the
+    // trackball is in progress, rather than from the DMA interrupt, as it
+    // may have to wait for the time required between accesses
+    #ifdef SCROLLBALL
+    scrollBall_.wakeStep();
+    scrollBall_.adnsBurstMotionStart();
+    #endif
 }
 
 
@@ -126,52 +366,86 @@ inline int8_t clip8(int16_t y)
 }
 
 
+void TrackBall::scroll(const int16_t dy)
+{
+    // Reset scroll counter if direction changes
+    if
+    (
+        (dy > 0 && scrollCount_ > 0)
+     || (dy < 0 && scrollCount_ < 0)
+    )
+    {
+        scrollCount_ = 0;
+    }
+
+    // Accumulate the scroll motion
+    scrollCount_ -= dy;
+
+    // Divide and clip the scroll motion before sending
+    reportPending_ =
+        !Mouse.move_latest(0, 0, clip8(scrollCount_/scrollDivider_));
+
+    // Reduce the scroll count according to that sent
+    // ignoring the clipping to limit scroll-speed
+    scrollCount_ %= scrollDivider_;
+}
+
+
 bool TrackBall::moveOrScroll(const bool moving)
 {
-    if (moved_)
+    bool moved = false;
+
+    // Get the ball motion read from the ADNS-9800 by readMotion
+    burstData data;
+
+    if (adnsBurstMotion(data))
     {
-        // Reset the interrupt flag
-        moved_ = false;
+        health_.update(data);
 
-        // Read the ball motion from the ADNS-9800
-        int16_t xy[2];
-        adnsBurstMotion(xy);
+        const uint32_t burstTime = micros();
+        const uint32_t interval = burstTime - burstTime_;
+        burstTime_ = burstTime;
 
-        if (moving)
-        {
-            // Clip the movement to -128 to 127 per call
-            // It would be possible to accumulate the overflow
-            // and apply subsequently but limiting the speed by clipping as
-            // is done here might be better anyway.
-            Mouse.move(clip8(-xy[1]), clip8(-xy[0]));
-        }
-        else
+        // Ignore motion while the ball is lifted off the sensor
+        if (!(data.motion & MOTION_LIFT))
         {
-            // Reset scroll counter if direction changes
-            if
-            (
-                (xy[0] > 0 && scrollCount_ > 0)
-             || (xy[0] < 0 && scrollCount_ < 0)
-            )
-            {
-                scrollCount_ = 0;
-            }
+            int16_t xy[2] = {data.dx, data.dy};
 
-            // Accumulate the scroll motion
-            scrollCount_ -= xy[0];
+            if (moving)
+            {
+                // The movement is clipped to -127 to 127 per call.
+                // It would be possible to accumulate the overflow
+                // and apply subsequently but limiting the speed by clipping
+                // as is done here might be better anyway.
+                pointer_.transfer(xy, interval);
 
-            // Divide and clip the scroll motion before sending
-            Mouse.scroll(clip8(scrollCount_/scrollDivider_));
+                reportPending_ = !Mouse.move_latest(-xy[1], -xy[0]);
+            }
+            else
+            {
+                scroll(xy[0]);
+            }
 
-            // Reduce the scroll count according to that sent
-            // ignoring the clipping to limit scroll-speed
-            scrollCount_ %= scrollDivider_;
+            moved = true;
         }
+    }
 
-        return true;
+    #ifdef SCROLLBALL
+    // The scroll ball always scrolls, combined into the same report
+    if (scrollBall_.adnsBurstMotion(data) && !(data.motion & MOTION_LIFT))
+    {
+        scroll(data.dx);
+        moved = true;
     }
+    #endif
 
-    return false;
+    if (!moved && reportPending_)
+    {
+        // Retry sending the latest position and scroll motion
+        reportPending_ = !Mouse.move_latest(0, 0);
+    }
+
+    return moved;
 }
 
 
@@ -27,6 +27,10 @@
 //    Both the pointer motion resolution and scroll divider are
 //    configurable by sending the new values via USB serial and stored in
 //    EEPROM.
+//
+//    If compiled with -DSCROLLBALL a second ADNS9800 on the SPI bus with
+//    select pin SCROLLBALL_NCS and motion pin SCROLLBALL_MOT is used as a
+//    dedicated scroll ball.
 // -----------------------------------------------------------------------------
 
 #ifndef TrackBall_H
@@ -34,6 +38,19 @@
 
 #include "WProgram.h"
 #include "ADNS9800.h"
+#include "SensorHealth.h"
+#include "PointerMotion.h"
+
+// -----------------------------------------------------------------------------
+
+#ifdef SCROLLBALL
+    #ifndef SCROLLBALL_NCS
+        #define SCROLLBALL_NCS 26
+    #endif
+    #ifndef SCROLLBALL_MOT
+        #define SCROLLBALL_MOT 27
+    #endif
+#endif
 
 // -----------------------------------------------------------------------------
 
@@ -47,31 +64,87 @@ class TrackBall
     //- Scroll divider reduce the scroll speed relative to the pointer motion.
     uint8_t scrollDivider_ = 50;
 
+    //- Number of points of the pointer acceleration curve
+    static const uint8_t nAccelPoints_ = PointerMotion::nAccelPoints_;
+
+    //- Acceleration and per-axis scale of the pointer motion
+    PointerMotion pointer_;
+
+    //- Time at which the previous motion burst was read [us]
+    uint32_t burstTime_ = 0;
+
+    //- Sensor profile selected while in use
+    uint8_t sensorProfile_ = balanced;
+
+    //- Sensor profile selected when idle
+    uint8_t idleSensorProfile_ = battery;
+
+    //- Set while idle, selecting idleSensorProfile_ rather than sensorProfile_
+    bool idle_ = false;
+
     //- Current scroll counter used with scrollDivider_ to reduce scroll speed
     int16_t scrollCount_ = 0;
 
-    //- Structure representing the storage of the parameters in EEPROM
+    //- Set if the latest pointer report could not be queued for the host
+    bool reportPending_ = false;
+
+    //- Set on wake from sleep to move the pointer when the ADNS9800 is ready
+    bool wakeScreen_ = false;
+
+    //- Rolling statistics of the sensor data from the motion burst
+    SensorHealth health_;
+
+    #ifdef SCROLLBALL
+    //- Second sensor used only to scroll
+    ADNS9800 scrollBall_;
+    #endif
+
+    //- Structure representing the storage of the parameters in the
+    //  ConfigStore, fields may only be appended
     struct parameters
     {
         uint8_t resolution;
         uint8_t scrollDivider;
+        uint8_t accelCurve[nAccelPoints_];
+        uint32_t scaleX;
+        uint32_t scaleY;
+        uint8_t sensorProfile;
+        uint8_t idleSensorProfile;
     };
 
-    //- Start of the EEPROM storage for the configuration parameters
+    //- Offset of the configuration parameters in the ConfigStore
     ptrdiff_t eepromStart_;
 
+    //- Capture n pixel frames and send them on Serial, each as the
+    //  header 'P' 'X' width height followed by the pixels row by row
+    void captureFrames(const uint8_t n);
+
+    //- Accumulate the scroll motion and send it divided by scrollDivider_
+    void scroll(const int16_t dy);
+
+    //- Select the idle or in-use sensor profile according to idle_
+    void selectProfile();
+
 
 public:
 
     // Constructor
-    TrackBall(const ptrdiff_t eepromStart);
+    TrackBall();
 
     // Member functions
 
         //- Setup SPI and ADNS9800 interfaces
         void begin();
 
-        //- Wake after sleep
+        //- Sleep to save power and the laser
+        void sleep();
+
+        //- Rest the trackball sensor in the battery profile so that motion
+        //  wakes the processor from deep sleep, the scroll ball is shut down
+        void rest();
+
+        //- Start waking after sleep, continued by readMotion(),
+        //  or restore the sensor profile after rest
         void wake();
 
         //- Configure from parameters stored in EEPROM
@@ -80,19 +153,24 @@ public:
         //- Configure parameters stored in EEPROM from Serial
         bool configure(const char cmd);
 
-        //- Return the end of the EEPROM storage
-        //  for the configuration parameters
-        ptrdiff_t eepromEnd()
-        {
-            return eepromStart_ + sizeof(parameters);
-        }
-
         //- Change and save the pointer movement resolution
         void resolution(const uint8_t res);
 
-        //- Change and save the scroll divider
+        //- Change and save the scroll divider, failing the configuration
+        //  command if it is zero
         void scrollDivider(const uint8_t sdiv);
 
+        //- Change and save a point of the acceleration curve
+        void accelCurve(const uint8_t i, const uint8_t gain);
+
+        //- Select the idle or in-use sensor profile
+        void idle(const bool idle);
+
+        //- Continue waking the ADNS9800 if necessary and
+        //  if the ball has moved start reading the motion in the background
+        //  followed by that of the scroll ball
+        void readMotion();
+
         //- If data is present move the pointer (if move = true)
         //  or scroll the screen (if move = false) and return true
         //  otherwise return false
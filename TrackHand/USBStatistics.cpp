@@ -0,0 +1,111 @@
+/// Copyright 2014 Henry G. Weller
+// -----------------------------------------------------------------------------
+//  This file is part of
+/// ---     TrackHand: DataHand with Laser TrackBall
+// -----------------------------------------------------------------------------
+//
+//  TrackHand is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  TrackHand is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+//  for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with TrackHand.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+
+#include "USBStatistics.h"
+#include "usb_dev.h"
+
+// -----------------------------------------------------------------------------
+
+void USBStatistics::printEndpoint
+(
+    const char* name,
+    const uint8_t endpoint
+) const
+{
+    Serial.print("USB ");
+    Serial.print(name);
+    Serial.print(" pending ");
+    Serial.print(usb_tx_packet_pending(endpoint));
+    Serial.print(" max ");
+    Serial.print(usb_tx_packet_high_water[endpoint - 1]);
+
+    // Take a consistent copy of the latency counters
+    __disable_irq();
+    const uint32_t sum = usb_tx_latency_sum[endpoint - 1];
+    const uint32_t count = usb_tx_latency_count[endpoint - 1];
+    const uint16_t max = usb_tx_latency_max[endpoint - 1];
+    __enable_irq();
+
+    Serial.print(" queue-to-read latency mean ");
+    Serial.print(count ? sum/count : 0);
+    Serial.print("us max ");
+    Serial.print(max);
+    Serial.println("us");
+}
+
+
+void USBStatistics::print() const
+{
+    // Take a consistent copy of the pool counters
+    __disable_irq();
+    const uint32_t nMalloc = usb_malloc_count;
+    const uint32_t nFail = usb_malloc_fail_count;
+    const uint8_t nUsed = usb_buffer_used;
+    const uint8_t nHighWater = usb_buffer_high_water;
+    __enable_irq();
+
+    Serial.print("USB buffers ");
+    Serial.print(NUM_USB_BUFFERS);
+    Serial.print(" used ");
+    Serial.print(nUsed);
+    Serial.print(" max ");
+    Serial.println(nHighWater);
+
+    Serial.print("USB allocations ");
+    Serial.print(nMalloc);
+    Serial.print(" failed ");
+    Serial.println(nFail);
+
+    printEndpoint("keyboard", KEYBOARD_ENDPOINT);
+    printEndpoint("mouse", MOUSE_ENDPOINT);
+    printEndpoint("serial", CDC_TX_ENDPOINT);
+
+    Serial.print("USB keyboard timeout drops ");
+    Serial.print(usb_keyboard_tx_timeout_count);
+    Serial.print(" overwritten ");
+    Serial.print(usb_keyboard_tx_overwrite_count);
+    Serial.print(" busy ");
+    Serial.println(usb_keyboard_tx_busy_count);
+
+    Serial.print("USB mouse timeout drops ");
+    Serial.print(usb_mouse_tx_timeout_count);
+    Serial.print(" overwritten ");
+    Serial.print(usb_mouse_tx_overwrite_count);
+    Serial.print(" busy ");
+    Serial.println(usb_mouse_tx_busy_count);
+}
+
+
+bool USBStatistics::configure(const char cmd)
+{
+    switch (cmd)
+    {
+        case 'u':
+            print();
+            return true;
+            break;
+    }
+
+    return false;
+}
+
+
+// -----------------------------------------------------------------------------
@@ -0,0 +1,59 @@
+/// Copyright 2014 Henry G. Weller
+// -----------------------------------------------------------------------------
+//  This file is part of
+/// ---     TrackHand: DataHand with Laser TrackBall
+// -----------------------------------------------------------------------------
+//
+//  TrackHand is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  TrackHand is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+//  for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with TrackHand.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+/// Title: USB packet-pool statistics
+///  Description:
+//    Reports the USB packet-pool usage, the packets pending on each endpoint,
+//    both queued and owned by the USB hardware, the transmit latencies, i.e.
+//    the time from queueing each report to the host reading it, which does
+//    not include the time taken to sample the keys and ball before queueing,
+//    and the number of keyboard and mouse reports discarded on transmit
+//    timeout.
+// -----------------------------------------------------------------------------
+
+#ifndef USBStatistics_H
+#define USBStatistics_H
+
+#include "WProgram.h"
+
+// -----------------------------------------------------------------------------
+
+class USBStatistics
+{
+    //- Print the current and maximum number of packets pending
+    //  and the queue-to-read transmit latency of the given endpoint
+    void printEndpoint(const char* name, const uint8_t endpoint) const;
+
+
+public:
+
+    // Member functions
+
+        //- Print the statistics on Serial
+        void print() const;
+
+        //- Handle the statistics commands from Serial
+        bool configure(const char cmd);
+};
+
+
+// -----------------------------------------------------------------------------
+#endif // USBStatistics_H
+// -----------------------------------------------------------------------------
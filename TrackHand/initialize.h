@@ -1 +0,0 @@
-const bool initialize = 0;
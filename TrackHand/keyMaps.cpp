@@ -259,7 +259,7 @@ const KEYCODE_TYPE KeyMatrix::functionKeyMap[KeyMatrix::nKeys] =
     KEY_F5,                   // 1 D
     KEY_RIGHT,                // 1 E
     KEY_F8,                   // 4 D
-    0,                        // 4 E
+    profileKey_,              // 4 E
     KEY_DOWN,                 // 1 S
     KEY_PAGE_DOWN,            // 2 S
     0,                        // 4 W
@@ -8,36 +8,92 @@
 
 // -----------------------------------------------------------------------------
 
-void ADNS9800::adnsBurstMotion(int16_t xy[2])
+bool ADNS9800::adnsBurstMotionStart()
 {
+    // The burst data must be read by adnsBurstMotion before the next
+    // and the sensor must have completed the wake sequence
+    if (!ready() || !moved_ || burstReady_)
+    {
+        return false;
+    }
+
+    __disable_irq();
+
+    // Retry on the next call when the transfer in progress, of this or
+    // another device on the SPI bus, has completed
+    if (spi4teensy3::dmaBusy())
+    {
+        __enable_irq();
+        return false;
+    }
+
+    // Reset the interrupt flag
+    moved_ = false;
+
+    __enable_irq();
+
+    adnsBurstStart();
+
+    return true;
+}
+
+
+void ADNS9800::adnsBurstStart()
+{
+    adnsWaitAccess();
     adnsComBegin();
 
     // Send adress of the register, with MSBit = 0 to indicate it's a read
     spi4teensy3::send(REG_Motion_Burst & 0x7f);
 
-    // tSRAD
-    delayMicroseconds(100);
+    // Read data in the background starting after tSRAD-MOTBR (=35us)
+    // with each byte pushed 1us after the previous has been clocked so that
+    // the transmit FIFO never overflows
+    burstReady_ = false;
+    transferring_ = this;
+    spi4teensy3::dmaReceive
+    (
+        burst_,
+        burstLength_,
+        transferComplete,
+        byteTime_ + 1,
+        35
+    );
+}
 
-    // Read data
-    uint8_t data[6];
-    spi4teensy3::receive(data, 6);
+
+bool ADNS9800::adnsBurstMotion(burstData& data)
+{
+    if (!burstReady_)
+    {
+        return false;
+    }
+
+    burstReady_ = false;
+
+    data.motion = burst_[0];
+    data.observation = burst_[1];
 
     // Construct the 16-bit x and y motion deltas
-    xy[0] = (data[3] << 8) | data[2];
-    xy[1] = (data[5] << 8) | data[4];
+    data.dx = (burst_[3] << 8) | burst_[2];
+    data.dy = (burst_[5] << 8) | burst_[4];
 
-    // tSCLK-NCS for read operation is 120ns
-    delayMicroseconds(1);
+    data.squal = burst_[6];
+    data.pixelSum = burst_[7];
+    data.maxPixel = burst_[8];
+    data.minPixel = burst_[9];
 
-    adnsComEnd();
+    // The shutter and frame period are sent upper byte first
+    data.shutter = (burst_[10] << 8) | burst_[11];
+    data.framePeriod = (burst_[12] << 8) | burst_[13];
 
-    //  tSRW/tSRR (=20us) minus tSCLK-NCS
-    delayMicroseconds(19);
+    return true;
 }
 
 
 uint8_t ADNS9800::adnsReadReg(uint8_t reg_addr)
 {
+    adnsWaitAccess();
     adnsComBegin();
 
     // Send adress of the register, with MSBit = 0 to indicate it's a read
@@ -53,8 +109,8 @@ uint8_t ADNS9800::adnsReadReg(uint8_t reg_addr)
     delayMicroseconds(1);
     adnsComEnd();
 
-    // tSRW/tSRR (=20us) minus tSCLK-NCS
-    delayMicroseconds(19);
+    // tSRW/tSRR (=20us) minus tSCLK-NCS before the next access
+    adnsAccessEnd(19);
 
     return data;
 }
@@ -62,6 +118,7 @@ uint8_t ADNS9800::adnsReadReg(uint8_t reg_addr)
 
 void ADNS9800::adnsWriteReg(uint8_t reg_addr, uint8_t data)
 {
+    adnsWaitAccess();
     adnsComBegin();
 
     // Send adress of the register, with MSBit = 1 to indicate it's a write
@@ -74,62 +131,182 @@ void ADNS9800::adnsWriteReg(uint8_t reg_addr, uint8_t data)
     delayMicroseconds(20);
     adnsComEnd();
 
-    // tSWW/tSWR (=120us) minus tSCLK-NCS.
-    delayMicroseconds(100);
-    // Could be shortened, but is looks like a safe lower bound
+    // tSWW/tSWR (=120us) minus tSCLK-NCS before the next access
+    adnsAccessEnd(100);
 }
 
 
-void ADNS9800::adnsUploadFirmware()
+const uint8_t ADNS9800::shadowRegs_[ADNS9800::nShadowRegs_] =
 {
-    // Send the firmware to the chip, cf p.18 of the datasheet
-    debugln("Uploading firmware...");
+    REG_Configuration_I,
+    REG_Configuration_II,
+
+    // The bounds must be written in this order, lower byte first,
+    // the write to Frame_Period_Max_Bound_Upper applying all three
+    REG_Shutter_Max_Bound_Lower,
+    REG_Shutter_Max_Bound_Upper,
+    REG_Frame_Period_Min_Bound_Lower,
+    REG_Frame_Period_Min_Bound_Upper,
+    REG_Frame_Period_Max_Bound_Lower,
+    REG_Frame_Period_Max_Bound_Upper,
+
+    REG_Configuration_V,
+    REG_Run_Downshift,
+    REG_Rest1_Rate,
+    REG_Rest1_Downshift,
+    REG_Rest2_Rate,
+    REG_Rest2_Downshift,
+    REG_Rest3_Rate,
+    REG_LASER_CTRL0,
+    REG_Lift_Detection_Thr
+};
+
+
+int8_t ADNS9800::adnsShadowIndex(const uint8_t reg_addr) const
+{
+    for (uint8_t i=0; i<nShadowRegs_; i++)
+    {
+        if (shadowRegs_[i] == reg_addr)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+
+bool ADNS9800::adnsSetReg(uint8_t reg_addr, uint8_t data)
+{
+    const int8_t i = adnsShadowIndex(reg_addr);
+
+    if (i < 0)
+    {
+        adnsWriteReg(reg_addr, data);
+        return true;
+    }
 
-    // Set the configuration_IV register in 3k firmware mode
-    // Bit 1 = 1 for 3k mode, other bits are reserved
-    adnsWriteReg(REG_Configuration_IV, 0x02);
+    const uint32_t bit = 1UL << i;
+
+    // Skip the write if the sensor already holds the value
+    if ((shadowValid_ & bit) && shadow_[i] == data)
+    {
+        return false;
+    }
+
+    shadow_[i] = data;
+    shadowSet_ |= bit;
+
+    if (ready())
+    {
+        adnsWriteReg(reg_addr, data);
+        shadowValid_ |= bit;
+    }
+    else
+    {
+        shadowValid_ &= ~bit;
+    }
+
+    return true;
+}
 
-    // Write 0x1d in SROM_enable reg for initializing
-    adnsWriteReg(REG_SROM_Enable, 0x1d);
 
-    // Wait for more than one frame period
-    // Assume that the frame rate is as low as 100fps...
-    // even if it should never be that low
-    delay(10);
+void ADNS9800::adnsRestoreRegs()
+{
+    for (uint8_t i=0; i<nShadowRegs_; i++)
+    {
+        const uint32_t bit = 1UL << i;
+
+        if ((shadowSet_ & bit) && !(shadowValid_ & bit))
+        {
+            adnsWriteReg(shadowRegs_[i], shadow_[i]);
+            shadowValid_ |= bit;
+        }
+    }
+}
+
+
+void ADNS9800::adnsUploadFirmware()
+{
+    // Send the firmware to the chip, cf p.18 of the datasheet
+    debugln("Uploading firmware...");
 
     // Write 0x18 to SROM_enable to start SROM download
     adnsWriteReg(REG_SROM_Enable, 0x18);
 
-    // Write the SROM file (=firmware data)
+    // Write the SROM file (=firmware data) after tSWW
+    adnsWaitAccess();
     adnsComBegin();
 
     // Write burst destination address
     spi4teensy3::send(REG_SROM_Load_Burst | 0x80);
 
-    delayMicroseconds(15);
+    // Send all bytes of the firmware by DMA paced at the time to clock each
+    // byte followed by more than the 15us tLOAD required between bytes,
+    // including the wait before the first
+    transferring_ = this;
+    spi4teensy3::dmaSend
+    (
+        firmwareData_,
+        firmwareLength_,
+        transferComplete,
+        byteTime_ + 16
+    );
+}
 
-    // Send all bytes of the firmware
-    for (int i=0; i<firmwareLength_; i++)
-    {
-        unsigned char c = pgm_read_byte(firmwareData_ + i);
-        spi4teensy3::send(c);
-        delayMicroseconds(15);
-    }
 
-    adnsComEnd();
+void ADNS9800::adnsWaitAccess()
+{
+    spi4teensy3::dmaWait();
+
+    // Wait for whatever remains of the time required after the last access
+    // allowing for the truncation of both times to whole microseconds
+    while (micros() - accessTime_ <= accessWait_)
+    {}
 }
 
 
-volatile bool ADNS9800::moved_ = false;
+ADNS9800* ADNS9800::instances_[ADNS9800::maxInstances_] = {NULL, NULL};
+
+void (* const ADNS9800::movedISRs_[ADNS9800::maxInstances_])() =
+{
+    ADNS9800::moved0,
+    ADNS9800::moved1
+};
+
+ADNS9800* ADNS9800::transferring_ = NULL;
+
+uint8_t ADNS9800::byteTime_ = 0;
 
 
-void ADNS9800::moved()
+void ADNS9800::transferComplete()
 {
-    ADNS9800::moved_ = true;
+    // tSCLK-NCS has elapsed since the last byte was received
+    transferring_->adnsComEnd();
+
+    // tSRW/tSRR (=20us) before the next access
+    transferring_->adnsAccessEnd(20);
+    // The SROM upload also completes here during the wake sequence
+    transferring_->burstReady_ = transferring_->wakeState_ == awake;
+}
+
+
+void ADNS9800::moved0()
+{
+    instances_[0]->moved_ = true;
 }
 
 
-ADNS9800::ADNS9800()
+void ADNS9800::moved1()
+{
+    instances_[1]->moved_ = true;
+}
+
+
+ADNS9800::ADNS9800(const uint8_t ncs, const uint8_t mot)
+:
+    ncs_(ncs),
+    mot_(mot)
 {}
 
 
@@ -137,23 +314,178 @@ void ADNS9800::begin()
 {
     // Setup SPI pins and interrupt for optical sensor
     pinMode(ncs_, OUTPUT);
+    digitalWrite(ncs_, HIGH);
     pinMode(mot_, INPUT);
-    attachInterrupt(mot_, moved, FALLING);
+
+    for (uint8_t i=0; i<maxInstances_; i++)
+    {
+        if (!instances_[i] || instances_[i] == this)
+        {
+            instances_[i] = this;
+            attachInterrupt(mot_, movedISRs_[i], FALLING);
+            break;
+        }
+    }
+
     wake();
 }
 
 
 void ADNS9800::setResolution(const uint8_t res)
 {
-    digitalWrite(ncs_, LOW);
-    adnsWriteReg(REG_Configuration_I, res);
-    digitalWrite(ncs_, HIGH);
+    adnsSetReg(REG_Configuration_I, res);
+}
+
+
+const ADNS9800::sensorProfile ADNS9800::profiles_[ADNS9800::nProfiles] =
+{
+    // Fixed 6250fps, short exposure and never rest
+    {
+        "maxPerformance",
+        CONFIG2_Fixed_FR,
+        0x1f40, 0x0fa0, 0x0fa0,
+        0xff, 0x00, 0xff, 0x09, 0xff, 0x31
+    },
+
+    // Sensor defaults: automatic frame rate and rest after 500ms
+    {
+        "balanced",
+        CONFIG2_Rest_En,
+        0x5dc0, 0x0fa0, 0x4e20,
+        0x32, 0x00, 0x1f, 0x09, 0xbc, 0x31
+    },
+
+    // Automatic frame rate, rest after 100ms and descend quickly
+    // to the slowest rest rate
+    {
+        "battery",
+        CONFIG2_Rest_En,
+        0x5dc0, 0x0fa0, 0x4e20,
+        0x0a, 0x09, 0x0a, 0x31, 0x20, 0xf9
+    }
+};
+
+
+void ADNS9800::setProfile(const sensorProfile& profile)
+{
+    adnsSetReg(REG_Configuration_II, profile.config2);
+
+    bool bounds = false;
+    bounds |= adnsSetReg
+    (
+        REG_Shutter_Max_Bound_Lower,
+        profile.shutterMaxBound & 0xff
+    );
+    bounds |= adnsSetReg
+    (
+        REG_Shutter_Max_Bound_Upper,
+        profile.shutterMaxBound >> 8
+    );
+    bounds |= adnsSetReg
+    (
+        REG_Frame_Period_Min_Bound_Lower,
+        profile.framePeriodMinBound & 0xff
+    );
+    bounds |= adnsSetReg
+    (
+        REG_Frame_Period_Min_Bound_Upper,
+        profile.framePeriodMinBound >> 8
+    );
+    bounds |= adnsSetReg
+    (
+        REG_Frame_Period_Max_Bound_Lower,
+        profile.framePeriodMaxBound & 0xff
+    );
+
+    // The bounds are only applied by writing Frame_Period_Max_Bound_Upper
+    // so write it if any have changed even if it has not
+    if (bounds)
+    {
+        shadowValid_ &=
+            ~(1UL << adnsShadowIndex(REG_Frame_Period_Max_Bound_Upper));
+    }
+    adnsSetReg
+    (
+        REG_Frame_Period_Max_Bound_Upper,
+        profile.framePeriodMaxBound >> 8
+    );
+
+    adnsSetReg(REG_Run_Downshift, profile.runDownshift);
+    adnsSetReg(REG_Rest1_Rate, profile.rest1Rate);
+    adnsSetReg(REG_Rest1_Downshift, profile.rest1Downshift);
+    adnsSetReg(REG_Rest2_Rate, profile.rest2Rate);
+    adnsSetReg(REG_Rest2_Downshift, profile.rest2Downshift);
+    adnsSetReg(REG_Rest3_Rate, profile.rest3Rate);
+}
+
+
+bool ADNS9800::captureFrame(uint8_t frame[framePixels_])
+{
+    if (!ready() && wakeState_ != capturing)
+    {
+        return false;
+    }
+
+    // Navigation, and with it the motion bursts, halts until the reset
+    wakeState_ = capturing;
+
+    // Start the frame capture, cf p.34 of the datasheet, repeated for each
+    // frame while the sensor remains in frame capture mode
+    adnsWriteReg(REG_Frame_Capture, 0x93);
+    adnsWriteReg(REG_Frame_Capture, 0xc5);
+
+    // Wait for two frames then poll for the first pixel
+    uint16_t framePeriod = adnsReadReg(REG_Frame_Period_Lower);
+    framePeriod |= adnsReadReg(REG_Frame_Period_Upper) << 8;
+    delayMicroseconds(2*(framePeriod/50 + 1));
+
+    const uint32_t start = millis();
+    while (!(adnsReadReg(REG_Motion) & MOTION_Pix_First))
+    {
+        if (millis() - start > 100)
+        {
+            wake();
+            return false;
+        }
+    }
+
+    adnsWaitAccess();
+    adnsComBegin();
+
+    // Send adress of the register, with MSBit = 0 to indicate it's a read
+    spi4teensy3::send(REG_Pixel_Burst & 0x7f);
+
+    // tSRAD
+    delayMicroseconds(100);
+
+    // Read the complete frame
+    spi4teensy3::receive(frame, framePixels_);
+
+    // tSCLK-NCS for read operation is 120ns
+    delayMicroseconds(1);
+    adnsComEnd();
+
+    // tSRW/tSRR (=20us) minus tSCLK-NCS before the next access
+    adnsAccessEnd(19);
+
+    return true;
+}
+
+
+void ADNS9800::captureEnd()
+{
+    // Reset the sensor to resume navigation
+    if (wakeState_ == capturing)
+    {
+        wake();
+    }
 }
 
 
 void ADNS9800::sleep()
 {
     adnsWriteReg(REG_Shutdown, 0xb6);
+    wakeState_ = asleep;
 
     // Switch off the SPI clock
     pinMode(SCK, OUTPUT);
@@ -163,43 +495,188 @@ void ADNS9800::sleep()
 }
 
 
+void ADNS9800::rest()
+{
+    if (wakeState_ != awake)
+    {
+        sleep();
+        return;
+    }
+
+    setProfile(profiles_[battery]);
+
+    // Complete any burst in progress
+    spi4teensy3::dmaWait();
+
+    // Read the motion to release MOT so that the next motion asserts it
+    adnsReadReg(REG_Motion);
+    adnsReadReg(REG_Delta_X_L);
+    adnsReadReg(REG_Delta_X_H);
+    adnsReadReg(REG_Delta_Y_L);
+    adnsReadReg(REG_Delta_Y_H);
+
+    __disable_irq();
+    moved_ = false;
+    burstReady_ = false;
+    __enable_irq();
+}
+
+
+void ADNS9800::spiInit()
+{
+    const uint8_t speed = spi4teensy3::speed(maxSclk_);
+    spi4teensy3::init(speed, 1, 1);
+
+    // The clock may be lower than the maximum, e.g. 1MHz at a 48MHz bus
+    const uint32_t sclk = spi4teensy3::sclk(speed);
+    byteTime_ = (8*1000000 + sclk - 1)/sclk;
+}
+
+
 void ADNS9800::wake()
 {
-    // 48MHz / 24 = 2MHz = fSCLK
-    spi4teensy3::init(5,1,1);
+    spiInit();
 
     // Ensure that the serial port is reset
     adnsComEnd();
     adnsComBegin();
     adnsComEnd();
 
-    // Force reset
+    // Force reset, returning all registers to their defaults
     adnsWriteReg(REG_Power_Up_Reset, 0x5a);
+    shadowValid_ = 0;
+
+    // Discard motion signalled before the reset, which is not burst until
+    // the sensor is ready
+    __disable_irq();
+    moved_ = false;
+    burstReady_ = false;
+    __enable_irq();
+
+    // Wait for it to reboot, continued in wakeStep()
+    wakeState_ = resetting;
+    wakeTime_ = micros();
+    wakeWait_ = 50000;
+}
 
-    // Wait for it to reboot
-    delay(50);
 
-    // Read registers 0x02 to 0x06 (and discard the data)
-    adnsReadReg(REG_Motion);
-    adnsReadReg(REG_Delta_X_L);
-    adnsReadReg(REG_Delta_X_H);
-    adnsReadReg(REG_Delta_Y_L);
-    adnsReadReg(REG_Delta_Y_H);
+bool ADNS9800::wakeStep()
+{
+    if
+    (
+        wakeState_ == asleep
+     || wakeState_ == awake
+     || wakeState_ == capturing
+    )
+    {
+        return false;
+    }
 
-    // Upload the firmware
-    adnsUploadFirmware();
-    delay(10);
+    if (micros() - wakeTime_ < wakeWait_ || spi4teensy3::dmaBusy())
+    {
+        return false;
+    }
 
-    // Enable laser (bit 0 = 0b), in normal mode (bits 3,2,1 = 000b)
-    // reading the actual value of the register is important because the real
-    // default value is different from what is said in the datasheet, and if you
-    // change the reserved bytes (like by writing 0x00...) it would not work.
-    uint8_t laser_ctrl0 = adnsReadReg(REG_LASER_CTRL0);
-    adnsWriteReg(REG_LASER_CTRL0, laser_ctrl0 & 0xf0 );
+    switch (wakeState_)
+    {
+        case resetting:
+        {
+            // Read registers 0x02 to 0x06 (and discard the data)
+            adnsReadReg(REG_Motion);
+            adnsReadReg(REG_Delta_X_L);
+            adnsReadReg(REG_Delta_X_H);
+            adnsReadReg(REG_Delta_Y_L);
+            adnsReadReg(REG_Delta_Y_H);
+
+            // Set the configuration_IV register in 3k firmware mode
+            // Bit 1 = 1 for 3k mode, other bits are reserved
+            adnsWriteReg(REG_Configuration_IV, 0x02);
+
+            // Write 0x1d in SROM_enable reg for initializing
+            adnsWriteReg(REG_SROM_Enable, 0x1d);
+
+            // Wait for more than one frame period, read in units of the
+            // 50MHz clock, or 10ms if the frame period is not available
+            uint16_t framePeriod = adnsReadReg(REG_Frame_Period_Lower);
+            framePeriod |= adnsReadReg(REG_Frame_Period_Upper) << 8;
+            wakeWait_ = framePeriod ? framePeriod/50 + 100 : 10000;
+            wakeState_ = sromEnabling;
+            break;
+        }
+
+        case sromEnabling:
+            adnsUploadFirmware();
+            wakeWait_ = 0;
+            wakeState_ = sromLoading;
+            break;
+
+        case sromLoading:
+            // A non-zero SROM_ID indicates that the firmware is running
+            if (adnsReadReg(REG_SROM_ID) == 0)
+            {
+                debugln("ADNS-9800 SROM upload failed");
+                wake();
+                return false;
+            }
+
+            // Start the SROM CRC test
+            adnsWriteReg(REG_SROM_Enable, 0x15);
+            wakeWait_ = 1000;
+            wakeState_ = sromChecking;
+            break;
+
+        case sromChecking:
+            if
+            (
+                adnsReadReg(REG_Data_Out_Upper) != 0xbe
+             || adnsReadReg(REG_Data_Out_Lower) != 0xef
+            )
+            {
+                // The CRC test takes about 10ms, poll until it has
+                // completed or restart the wake sequence if it has failed
+                if (micros() - wakeTime_ > 50000)
+                {
+                    debugln("ADNS-9800 SROM CRC check failed");
+                    wake();
+                }
+                return false;
+            }
+
+            // Enable laser (bit 0 = 0b), in normal mode (bits 3,2,1 = 000b)
+            // reading the actual value of the register is important because
+            // the real default value is different from what is said in the
+            // datasheet, and if you change the reserved bytes (like by
+            // writing 0x00...) it would not work.
+            // A LASER_CTRL0 value set before the wake takes precedence.
+            {
+                const int8_t i = adnsShadowIndex(REG_LASER_CTRL0);
+
+                if (!(shadowSet_ & (1UL << i)))
+                {
+                    uint8_t laser_ctrl0 = adnsReadReg(REG_LASER_CTRL0);
+                    shadow_[i] = laser_ctrl0 & 0xf0;
+                    shadowSet_ |= 1UL << i;
+                }
+            }
+
+            // Write the laser control and all other registers set while
+            // the sensor was not ready in one batch
+            adnsRestoreRegs();
+
+            burstReady_ = false;
+            moved_ = false;
+            wakeState_ = awake;
+            debugln("ADNS-9800 Initialized");
+            return true;
+
+        default:
+            break;
+    }
 
-    delay(100);
+    // Time the next step from the end of this one
+    wakeTime_ = micros();
 
-    debugln("ADNS-9800 Initialized");
+    return false;
 }
 
 
@@ -8,7 +8,8 @@
 //    with updates for the Teensy-3.1 from
 //      https://github.com/pepijndevos/Dwergmuis
 //
-//    Added support for low-power sleep mode.
+//    Added support for low-power sleep mode and for more than one device on
+//    the SPI bus each with its own select and motion interrupt pins.
 // -----------------------------------------------------------------------------
 
 #ifndef ADNS9800_H
@@ -63,6 +64,18 @@
 #define REG_SROM_Load_Burst                      0x62
 #define REG_Pixel_Burst                          0x64
 
+// Configuration_II register bits
+#define CONFIG2_Rest_En                          0x20
+#define CONFIG2_NAGC                             0x10
+#define CONFIG2_Fixed_FR                         0x08
+
+// Motion register bits
+#define MOTION_MOT                               0x80
+#define MOTION_LP_Valid                          0x20
+#define MOTION_Fault                             0x10
+#define MOTION_LIFT                              0x08
+#define MOTION_Pix_First                         0x01
+
 // -----------------------------------------------------------------------------
 
 class ADNS9800
@@ -74,12 +87,167 @@ class ADNS9800
     static const uint8_t firmwareData_[firmwareLength_];
 
 
+    //- Number of bytes read by the motion burst, the complete burst from
+    //  Motion to Frame_Period_Lower
+    static const uint8_t burstLength_ = 14;
+
+    //- Motion burst data filled by DMA
+    uint8_t burst_[burstLength_];
+
+    //- Set by the completion of the motion burst DMA transfer
+    volatile bool burstReady_ = false;
+
+    //- Maximum SPI clock frequency [Hz]
+    static const uint32_t maxSclk_ = 2000000;
+
+    //- Time to clock a byte at the SPI clock set by spiInit(), rounded up to
+    //  whole microseconds to pace the DMA transfers [us]
+    static uint8_t byteTime_;
+
+    //- Maximum number of devices
+    static const uint8_t maxInstances_ = 2;
+
+    //- The devices which have begun, used to dispatch the interrupts
+    static ADNS9800* instances_[maxInstances_];
+
+    //- The motion interrupt functions for each of the devices
+    static void (* const movedISRs_[maxInstances_])();
+
+    //- Device for which the DMA transfer is in progress
+    static ADNS9800* transferring_;
+
+    //- The static DMA completion function ending the transfer, which
+    //  leaves starting the motion burst of another device to the main loop
+    //  as that waits for the time required between accesses
+    static void transferComplete();
+
+    //- Send the motion burst address and start the DMA read
+    void adnsBurstStart();
+
+
+    //- States of the wake sequence
+    enum wakeState
+    {
+        asleep,
+        resetting,
+        sromEnabling,
+        sromLoading,
+        sromChecking,
+        awake,
+        capturing
+    };
+
+    //- Current state of the wake sequence
+    wakeState wakeState_ = asleep;
+
+    //- Time at which the current wake state started [us]
+    uint32_t wakeTime_ = 0;
+
+    //- Time to wait in the current wake state before continuing [us]
+    uint32_t wakeWait_ = 0;
+
+
+    //- Number of writable registers shadowed
+    static const uint8_t nShadowRegs_ = 17;
+
+    //- Addresses of the shadowed registers
+    static const uint8_t shadowRegs_[nShadowRegs_];
+
+    //- Values of the shadowed registers
+    uint8_t shadow_[nShadowRegs_];
+
+    //- Bit set for each shadowed register value set by adnsSetReg
+    uint32_t shadowSet_ = 0;
+
+    //- Bit set for each shadowed register value held by the sensor
+    uint32_t shadowValid_ = 0;
+
+    //- Return the index of the register in shadowRegs_ or -1
+    int8_t adnsShadowIndex(const uint8_t reg_addr) const;
+
+    //- Write the shadowed registers set but not held by the sensor
+    void adnsRestoreRegs();
+
+
+public:
+
+    //- Frame-rate and rest-mode settings of the sensor
+    struct sensorProfile
+    {
+        //- Name printed when the profile is selected
+        const char* name;
+
+        //- Configuration_II with the Rest_En and Fixed_FR bits
+        uint8_t config2;
+
+        //- Frame period bounds and shutter bound in 50MHz clock cycles
+        uint16_t framePeriodMaxBound;
+        uint16_t framePeriodMinBound;
+        uint16_t shutterMaxBound;
+
+        //- Downshift times and rest frame rates
+        uint8_t runDownshift;
+        uint8_t rest1Rate;
+        uint8_t rest1Downshift;
+        uint8_t rest2Rate;
+        uint8_t rest2Downshift;
+        uint8_t rest3Rate;
+    };
+
+    //- Names of the predefined sensor profiles
+    enum profileName
+    {
+        maxPerformance,
+        balanced,
+        battery,
+        nProfiles
+    };
+
+    //- Width and height of the pixel frame
+    static const uint8_t frameSize_ = 30;
+
+    //- Number of pixels in the frame
+    static const uint16_t framePixels_ = frameSize_*frameSize_;
+
+    //- Sensor data read by the motion burst
+    struct burstData
+    {
+        uint8_t motion;
+        uint8_t observation;
+        int16_t dx;
+        int16_t dy;
+        uint8_t squal;
+        uint8_t pixelSum;
+        uint8_t maxPixel;
+        uint8_t minPixel;
+        uint16_t shutter;
+        uint16_t framePeriod;
+    };
+
+
 protected:
 
-    void adnsBurstMotion(int16_t xy[2]);
+    //- The predefined sensor profiles
+    static const sensorProfile profiles_[nProfiles];
+
     uint8_t adnsReadReg(uint8_t reg_addr);
     void adnsWriteReg(uint8_t reg_addr, uint8_t data);
+
+    //- Write the register if the value differs from that held by the
+    //  sensor and return true, otherwise return false.  Shadowed registers
+    //  set while the sensor is not ready are written when the wake sequence
+    //  completes.
+    bool adnsSetReg(uint8_t reg_addr, uint8_t data);
     void adnsUploadFirmware();
+    void adnsWaitAccess();
+
+    //- Record the end of an access after which wait [us]
+    //  must elapse before the next
+    inline void adnsAccessEnd(const uint8_t wait)
+    {
+        accessTime_ = micros();
+        accessWait_ = wait;
+    }
 
     inline void adnsComBegin()
     {
@@ -91,24 +259,31 @@ protected:
         digitalWrite(ncs_, HIGH);
     }
 
+    //- Time of the end of the last access [us]
+    volatile uint32_t accessTime_ = 0;
+
+    //- Time required after the last access before the next [us]
+    volatile uint8_t accessWait_ = 0;
+
     //- SPI device select pin
-    const uint8_t ncs_ = SS;
+    const uint8_t ncs_;
 
     //- Motion interupt pin
-    const uint8_t mot_ = 9;
+    const uint8_t mot_;
 
-    //- Moved indicator has to be a static member
-    //  as it is used in...
-    static volatile bool moved_;
+    //- Moved indicator set by the motion interrupt
+    volatile bool moved_ = false;
 
-    //- The static interrupt function indicating ball motion
-    static void moved();
+    //- The static interrupt functions indicating ball motion
+    //  of the first and second devices
+    static void moved0();
+    static void moved1();
 
 
 public:
 
     // Constructor
-    ADNS9800();
+    ADNS9800(const uint8_t ncs = SS, const uint8_t mot = 9);
 
     // Member functions
 
@@ -118,11 +293,62 @@ public:
         //- Change the resolution for movement or scroll
         void setResolution(const uint8_t res);
 
+        //- Capture a pixel frame, returning false if the sensor is not ready
+        //  or the capture fails.  Navigation is halted by the first capture
+        //  so that further frames are read back to back until captureEnd().
+        //  If the capture fails the wake sequence is restarted.
+        bool captureFrame(uint8_t frame[framePixels_]);
+
+        //- End the frame captures, restarting the wake sequence to resume
+        //  navigation, continued by calling wakeStep()
+        void captureEnd();
+
+        //- Return the predefined sensor profile i, wrapped into range
+        static const sensorProfile& profile(const uint8_t i)
+        {
+            return profiles_[i % nProfiles];
+        }
+
+        //- Select the frame-rate and rest-mode profile,
+        //  only the registers which change are written
+        void setProfile(const sensorProfile& profile);
+
         //- Sleep to save power and the laser
         void sleep();
 
-        //- Wake after sleep
+        //- Rest in the battery profile rather than shut down so that motion
+        //  asserts MOT, e.g. to wake the processor from deep sleep.
+        //  Any motion pending is discarded.  The sensor is shut down if it
+        //  is not ready.
+        void rest();
+
+        //- Start the wake sequence after sleep
+        //  which continues in the background by calling wakeStep().
+        //  Any motion pending is discarded.
         void wake();
+
+        //- Configure the SPI bus for the sensor at the bus clock currently
+        //  running, called by wake() and after the clock is changed
+        void spiInit();
+
+        //- Continue the wake sequence,
+        //  return true when the sensor has just become ready
+        bool wakeStep();
+
+        //- Return true if the wake sequence has completed
+        bool ready() const
+        {
+            return wakeState_ == awake;
+        }
+
+        //- If the sensor is ready and the ball has moved start reading the
+        //  motion burst in the background and return true, or return false
+        //  to be called again while the transfer of any device on the SPI
+        //  bus is in progress
+        bool adnsBurstMotionStart();
+
+        //- If the motion burst has been read return the data and true
+        bool adnsBurstMotion(burstData& data);
 };
 
 
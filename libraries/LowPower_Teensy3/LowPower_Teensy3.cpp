@@ -200,6 +200,8 @@ int TEENSY3_LP::CPU(uint32_t cpu) {
         _cpu = F_CPU;
         _bus = F_BUS;
         _mem = F_MEM;
+        F_CPU_ACTUAL = _cpu;
+        F_BUS_ACTUAL = _bus;
         ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
             systick_millis_count = 0;
             SYST_CVR = 0;
@@ -210,6 +212,8 @@ int TEENSY3_LP::CPU(uint32_t cpu) {
         _cpu = BLPI_CPU;
         _bus = BLPI_BUS;
         _mem = BLPI_MEM;
+        F_CPU_ACTUAL = _cpu;
+        F_BUS_ACTUAL = _bus;
         usbDisable();
         ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
             // transition from PEE to BLPI
@@ -227,6 +231,8 @@ int TEENSY3_LP::CPU(uint32_t cpu) {
         _cpu = BLPE_CPU;
         _bus = BLPE_BUS;
         _mem = BLPE_MEM;
+        F_CPU_ACTUAL = _cpu;
+        F_BUS_ACTUAL = _bus;
         usbDisable();
         ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
             // transition from PEE to BLPE
@@ -244,6 +250,8 @@ int TEENSY3_LP::CPU(uint32_t cpu) {
         _cpu = EIGHT_MHZ;
         _bus = EIGHT_MHZ;
         _mem = EIGHT_MHZ;
+        F_CPU_ACTUAL = _cpu;
+        F_BUS_ACTUAL = _bus;
         usbDisable();
         ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
             // transition from PEE to BLPE
@@ -259,6 +267,8 @@ int TEENSY3_LP::CPU(uint32_t cpu) {
         _cpu = SIXTEEN_MHZ;
         _bus = SIXTEEN_MHZ;
         _mem = SIXTEEN_MHZ;
+        F_CPU_ACTUAL = _cpu;
+        F_BUS_ACTUAL = _bus;
         usbDisable();
         ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
             // transition from PEE to BLPE
@@ -275,6 +285,8 @@ int TEENSY3_LP::CPU(uint32_t cpu) {
         _cpu = F_CPU;
         _bus = F_BUS;
         _mem = F_MEM;
+        F_CPU_ACTUAL = _cpu;
+        F_BUS_ACTUAL = _bus;
         return -1;
     }
 }
@@ -173,4 +173,18 @@ void MCP23018::writeBit(uint8_t bit, bool val)
 }
 
 
+void MCP23018::interruptOnLowA(uint8_t mask)
+{
+    writeReg(IOCON, IOCON_MIRROR | IOCON_ODR | IOCON_INTCC);
+
+    // Interrupt while the bits differ from the default of 1
+    writeReg(DEFVALA, mask);
+    writeReg(INTCONA, mask);
+    writeReg(GPINTENA, mask);
+
+    // Clear any interrupt pending
+    readReg(INTCAPA);
+}
+
+
 // -----------------------------------------------------------------------------
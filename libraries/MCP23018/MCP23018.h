@@ -44,13 +44,24 @@ class MCP23018
 
     static const uint8_t IODIRA = 0x0;
     static const uint8_t IODIRB = 0x1;
+    static const uint8_t GPINTENA = 0x04;
+    static const uint8_t DEFVALA = 0x06;
+    static const uint8_t INTCONA = 0x08;
+    static const uint8_t IOCON = 0x0A;
     static const uint8_t GPPUA = 0x0C;
     static const uint8_t GPPUB = 0x0D;
+    static const uint8_t INTCAPA = 0x10;
     static const uint8_t GPIOA = 0x12;
     static const uint8_t GPIOB = 0x13;
     static const uint8_t OLATA = 0x14;
     static const uint8_t OLATB = 0x15;
 
+    // IOCON bits
+
+    static const uint8_t IOCON_MIRROR = 0x40;
+    static const uint8_t IOCON_ODR = 0x04;
+    static const uint8_t IOCON_INTCC = 0x01;
+
     // The I2C connection to communicate over
     i2c_t3& wire_;
 
@@ -141,6 +152,11 @@ public:
 
     //- Write val to bit
     void writeBit(uint8_t bit, bool val);
+
+    //- Enable the interrupt while any of the port A bits specified by mask
+    //  read low, or disable it if mask is 0.  INTA and INTB are mirrored
+    //  and open-drain so that either may be wired-OR with other sources.
+    void interruptOnLowA(uint8_t mask);
 };
 
 
@@ -107,12 +107,12 @@ struct i2cStruct i2c_t3::i2cData[] =
 {
     {&I2C0_A1, &I2C0_F, &I2C0_C1, &I2C0_S, &I2C0_D, &I2C0_C2,
      &I2C0_FLT, &I2C0_RA, &I2C0_SMB, &I2C0_A2, &I2C0_SLTH, &I2C0_SLTL,
-     {}, 0, 0, {}, 0, 0, I2C_MASTER, I2C_PINS_18_19, I2C_STOP, I2C_WAITING,
+     {}, 0, 0, {}, 0, 0, I2C_MASTER, I2C_PINS_18_19, I2C_STOP, I2C_RATE_100, I2C_WAITING,
      0, 0, 0, 0, NULL, NULL}
 #if I2C_BUS_NUM >= 2
    ,{&I2C1_A1, &I2C1_F, &I2C1_C1, &I2C1_S, &I2C1_D, &I2C1_C2,
      &I2C1_FLT, &I2C1_RA, &I2C1_SMB, &I2C1_A2, &I2C1_SLTH, &I2C1_SLTL,
-     {}, 0, 0, {}, 0, 0, I2C_MASTER, I2C_PINS_29_30, I2C_STOP, I2C_WAITING,
+     {}, 0, 0, {}, 0, 0, I2C_MASTER, I2C_PINS_29_30, I2C_STOP, I2C_RATE_100, I2C_WAITING,
      0, 0, 0, 0, NULL, NULL}
 #endif
 };
@@ -227,41 +227,8 @@ void i2c_t3::begin_(struct i2cStruct* i2c, uint8_t bus, i2c_mode mode, uint8_t a
         }
     #endif
 
-    // Set rate and filter
-    #if F_BUS == 48000000
-        switch(rate)                                   // Freq  SCL Div
-        {                                              // ----  -------
-        case I2C_RATE_100:  *(i2c->F) = 0x27; break;   // 100k    480
-        case I2C_RATE_200:  *(i2c->F) = 0x1F; break;   // 200k    240
-        case I2C_RATE_300:  *(i2c->F) = 0x1D; break;   // 300k    160
-        case I2C_RATE_400:  *(i2c->F) = 0x85; break;   // 400k    120
-        case I2C_RATE_600:  *(i2c->F) = 0x14; break;   // 600k     80
-        case I2C_RATE_800:  *(i2c->F) = 0x45; break;   // 800k     60
-        case I2C_RATE_1000: *(i2c->F) = 0x0D; break;   // 1.0M     48
-        case I2C_RATE_1200: *(i2c->F) = 0x0B; break;   // 1.2M     40
-        case I2C_RATE_1500: *(i2c->F) = 0x09; break;   // 1.5M     32
-        case I2C_RATE_2000: *(i2c->F) = 0x02; break;   // 2.0M     24
-        case I2C_RATE_2400: *(i2c->F) = 0x00; break;   // 2.4M     20
-        default:            *(i2c->F) = 0x27; break;   // 100k    480 (defaults to slowest)
-        }
-        *(i2c->FLT) = 4;
-    #elif F_BUS == 24000000
-        switch(rate)                                   // Freq  SCL Div
-        {                                              // ----  -------
-        case I2C_RATE_100:  *(i2c->F) = 0x1F; break;   // 100k    240
-        case I2C_RATE_200:  *(i2c->F) = 0x85; break;   // 200k    120
-        case I2C_RATE_300:  *(i2c->F) = 0x14; break;   // 300k     80
-        case I2C_RATE_400:  *(i2c->F) = 0x45; break;   // 400k     60
-        case I2C_RATE_600:  *(i2c->F) = 0x0B; break;   // 600k     40
-        case I2C_RATE_800:  *(i2c->F) = 0x05; break;   // 800k     30
-        case I2C_RATE_1000: *(i2c->F) = 0x02; break;   // 1.0M     24
-        case I2C_RATE_1200: *(i2c->F) = 0x00; break;   // 1.2M     20
-        default:            *(i2c->F) = 0x1F; break;   // 100k    240 (defaults to slowest)
-        }
-        *(i2c->FLT) = 2;
-    #else
-        #error "F_BUS must be 48 MHz or 24 MHz"
-    #endif
+    // Set rate and filter for the bus clock currently running
+    setRate_(i2c, F_BUS_ACTUAL, rate);
 
     // Set config registers
     if(i2c->currentMode == I2C_MASTER)
@@ -290,6 +257,60 @@ void i2c_t3::begin_(struct i2cStruct* i2c, uint8_t bus, i2c_mode mode, uint8_t a
 }
 
 
+// ------------------------------------------------------------------------------------------------------
+// Set I2C rate - sets the frequency divider and input filter for the given bus frequency, e.g. after the
+//                bus clock is changed at run time (only works when bus is idle).  The divider is the
+//                smallest giving an SCL frequency no higher than the rate.
+// return: 1=success, 0=fail (bus busy)
+// parameters:
+//      busFreq = bus frequency (Hz), typically F_BUS_ACTUAL
+//      rate = I2C_RATE_100, I2C_RATE_200, I2C_RATE_300, I2C_RATE_400, I2C_RATE_600, I2C_RATE_800, I2C_RATE_1000,
+//             I2C_RATE_1200, I2C_RATE_1500, I2C_RATE_2000, I2C_RATE_2400
+//
+uint8_t i2c_t3::setRate_(struct i2cStruct* i2c, uint32_t busFreq, i2c_rate rate)
+{
+    // SCL divider for each ICR value with MULT=1, see the I2C divider and hold values table
+    static const uint16_t icrDivider[64] =
+        {  20,   22,   24,   26,   28,   30,   34,   40,   28,   32,   36,   40,   44,   48,   56,   68,
+           48,   56,   64,   72,   80,   88,  104,  128,   80,   96,  112,  128,  144,  160,  192,  240,
+          160,  192,  224,  256,  288,  320,  384,  480,  320,  384,  448,  512,  576,  640,  768,  960,
+          640,  768,  896, 1024, 1152, 1280, 1536, 1920, 1280, 1536, 1792, 2048, 2304, 2560, 3072, 3840};
+
+    // SCL frequency of each rate (kHz)
+    static const uint16_t rateKHz[] = {100, 200, 300, 400, 600, 800, 1000, 1200, 1500, 2000, 2400};
+
+    if(*(i2c->S) & I2C_S_BUSY) return 0; // return immediately if bus busy
+
+    if(rate > I2C_RATE_2400) rate = I2C_RATE_100; // defaults to slowest
+    i2c->currentRate = rate;
+
+    // Smallest divider, with multiplier 1, 2 or 4, not below the required division
+    uint32_t hz = rateKHz[rate]*1000;
+    uint32_t target = (busFreq + hz - 1)/hz;
+    uint32_t best = 4*3840;
+    uint8_t f = 0xBF;
+    for(uint8_t mult = 0; mult < 3; mult++)
+    {
+        for(uint8_t icr = 0; icr < 64; icr++)
+        {
+            uint32_t div = icrDivider[icr] << mult;
+            if(div >= target && div < best)
+            {
+                best = div;
+                f = (mult << 6) | icr;
+            }
+        }
+    }
+    *(i2c->F) = f;
+
+    // Glitch filter of about 80ns, 4 bus cycles at 48MHz
+    uint32_t flt = busFreq/12000000;
+    *(i2c->FLT) = (flt < 31) ? flt : 31;
+
+    return 1;
+}
+
+
 // ------------------------------------------------------------------------------------------------------
 // Configure I2C pins - reconfigures active I2C pins on-the-fly (only works when bus is idle).  Inactive pins
 //                      will switch to input mode using same pullup configuration.
@@ -424,6 +424,7 @@ struct i2cStruct
     i2c_mode currentMode;                    // Current Mode                      (User)
     i2c_pins currentPins;                    // Current Pins                      (User)
     i2c_stop currentStop;                    // Current Stop                      (User)
+    i2c_rate currentRate;                    // Current Rate                      (User)
     volatile i2c_status currentStatus;       // Current Status                    (User&ISR)
     uint8_t  rxAddr;                         // Rx Address                        (ISR)
     size_t   reqCount;                       // Byte Request Count                (User)
@@ -515,6 +516,23 @@ public:
     inline void begin(i2c_mode mode, uint8_t address1, uint8_t address2, i2c_pins pins, i2c_pullup pullup, i2c_rate rate)
         { begin_(i2c, bus, mode, address1, address2, pins, pullup, rate); }
 
+    // ------------------------------------------------------------------------------------------------------
+    // Set I2C rate (base routine)
+    //
+    static uint8_t setRate_(struct i2cStruct* i2c, uint32_t busFreq, i2c_rate rate);
+    //
+    // Set I2C rate - sets the frequency divider for the given bus frequency, e.g. after the bus clock is
+    //                changed at run time (only works when bus is idle)
+    // return: 1=success, 0=fail (bus busy)
+    // parameters:
+    //      busFreq = bus frequency (Hz), typically F_BUS_ACTUAL
+    //      rate = I2C_RATE_100, I2C_RATE_200, I2C_RATE_300, I2C_RATE_400, I2C_RATE_600, I2C_RATE_800, I2C_RATE_1000,
+    //             I2C_RATE_1200, I2C_RATE_1500, I2C_RATE_2000, I2C_RATE_2400
+    //             or the current rate if omitted
+    //
+    inline uint8_t setRate(uint32_t busFreq, i2c_rate rate) { return setRate_(i2c, busFreq, rate); }
+    inline uint8_t setRate(uint32_t busFreq) { return setRate_(i2c, busFreq, i2c->currentRate); }
+
     // ------------------------------------------------------------------------------------------------------
     // Configure I2C pins (base routine)
     //
@@ -30,13 +30,18 @@
  * ------+-------------+----------+----------
  *   4   |      16     |  3MHz    | 1.5MHz
  * ------+-------------+----------+----------
- *   5   |      32     |  1.5MHz  | 750KHz
+ *   5   |      48     |  1MHz    | 500KHz
  * ------+-------------+----------+----------
- *   6   |      64     |  750KHz  | 375KHz
+ *   6   |      96     |  500KHz  | 250KHz
  * ------+-------------+----------+----------
- *   7   |      128    |  375KHz  | 187.5KHz
+ *   7   |      192    |  250KHz  | 125KHz
  * ------+-------------+----------+----------
  *
+ * speed(hz) returns the value for a maximum SCLK at the bus clock currently
+ * running so that the SPI can be re-initialized if the clock is changed.
+ * sclk(speed) returns the SCLK a value gives at the bus clock currently
+ * running, e.g. to pace transfers by the time a byte takes.
+ *
  * cpol is the SPI clock Polarity
  * cpha is the SPI clock capture Phase
  *
@@ -89,6 +94,12 @@ namespace spi4teensy3 {
         uint32_t ctar0;
         uint32_t ctar1;
 
+        // State of the DMA transfer, see dmaSend and dmaReceive.
+        volatile bool dmaActive = false;
+        void (*dmaCallback)() = NULL;
+        uint8_t dmaFill = 0xFF;
+        uint8_t dmaDiscard;
+
         void updatectars() {
                 // This function is only used internally.
                 uint32_t mcr = SPI0_MCR;
@@ -159,15 +170,15 @@ namespace spi4teensy3 {
                                 ctar = SPI_CTAR_BR(3);
                                 break;
 
-                        case 5: // 1/32
+                        case 5: // 1/48
                                 ctar = SPI_CTAR_PBR(1) | SPI_CTAR_BR(4);
                                 break;
 
-                        case 6: // 1/64
+                        case 6: // 1/96
                                 ctar = SPI_CTAR_PBR(1) | SPI_CTAR_BR(5);
                                 break;
 
-                        case 7: //1/128
+                        case 7: // 1/192
                                 ctar = SPI_CTAR_PBR(1) | SPI_CTAR_BR(6);
                                 // fall thru
                         default:
@@ -193,6 +204,35 @@ namespace spi4teensy3 {
                 updatectars();
         }
 
+        /**
+         * Return the speed value for the fastest SCLK not exceeding hz at the
+         * bus clock currently running, e.g. after a change at run time.
+         *
+         * @param hz maximum SPI clock frequency
+         * @return SPI speed [0-7]
+         */
+        uint8_t speed(uint32_t hz) {
+                uint8_t s;
+                for(s = 0; s < 7; s++) {
+                        if(sclk(s) <= hz) {
+                                break;
+                        }
+                }
+                return s;
+        }
+
+        /**
+         * Return the SCLK frequency a speed value gives at the bus clock
+         * currently running, see the table above.
+         *
+         * @param SPI speed [0-7]
+         * @return SPI clock frequency in Hz
+         */
+        uint32_t sclk(uint8_t speed) {
+                static const uint8_t divisors[] = {2, 4, 8, 12, 16, 48, 96, 192};
+                return F_BUS_ACTUAL / divisors[speed < sizeof(divisors) ? speed : 0];
+        }
+
         /**
          * Send 1 byte.
          *
@@ -303,5 +343,142 @@ namespace spi4teensy3 {
                 }
 
         }
+
+        /**
+         * Start a DMA transfer of n bytes.
+         * DMA channel 0 pushes the bytes into the TX FIFO, either as fast as
+         * the FIFO accepts them or, if interval is not 0, one byte every
+         * interval microseconds triggered by PIT 0, the first after delay
+         * microseconds if delay is not 0.
+         * DMA channel 1 drains the RX FIFO and its completion interrupt,
+         * which occurs only after the last byte is clocked out, ends the
+         * transfer.
+         * DMA channels 0 and 1 and PIT 0 are owned by these transfers, see
+         * spi4teensy3.h.
+         * This function is only used internally.
+         */
+        void dmaStart(const void *txbufr, int16_t txoff, void *rxbufr, int16_t rxoff, size_t n, void (*callback)(), uint16_t interval, uint16_t delay) {
+                SIM_SCGC6 |= SIM_SCGC6_DMAMUX;
+                SIM_SCGC7 |= SIM_SCGC7_DMA;
+                dmaActive = true;
+                dmaCallback = callback;
+
+                // clear any data in RX/TX FIFOs, and be certain we are in master mode.
+                SPI0_MCR = SPI_MCR_MSTR | SPI_MCR_CLR_RXF | SPI_MCR_CLR_TXF | SPI_MCR_PCSIS(0x1F);
+                SPI0_SR = SPI_SR_TCF | SPI_SR_EOQF | SPI_SR_TFUF | SPI_SR_TFFF | SPI_SR_RFOF | SPI_SR_RFDF;
+
+                // 8-bit writes to PUSHR use CTAR0, i.e. 8-bit frames
+                DMA_TCD0_SADDR = txbufr;
+                DMA_TCD0_SOFF = txoff;
+                DMA_TCD0_ATTR = DMA_TCD_ATTR_SSIZE(DMA_TCD_ATTR_SIZE_8BIT) | DMA_TCD_ATTR_DSIZE(DMA_TCD_ATTR_SIZE_8BIT);
+                DMA_TCD0_NBYTES_MLNO = 1;
+                DMA_TCD0_SLAST = 0;
+                DMA_TCD0_DADDR = &SPI0_PUSHR;
+                DMA_TCD0_DOFF = 0;
+                DMA_TCD0_CITER_ELINKNO = n;
+                DMA_TCD0_DLASTSGA = 0;
+                DMA_TCD0_BITER_ELINKNO = n;
+                DMA_TCD0_CSR = DMA_TCD_CSR_DREQ;
+
+                DMA_TCD1_SADDR = &SPI0_POPR;
+                DMA_TCD1_SOFF = 0;
+                DMA_TCD1_ATTR = DMA_TCD_ATTR_SSIZE(DMA_TCD_ATTR_SIZE_8BIT) | DMA_TCD_ATTR_DSIZE(DMA_TCD_ATTR_SIZE_8BIT);
+                DMA_TCD1_NBYTES_MLNO = 1;
+                DMA_TCD1_SLAST = 0;
+                DMA_TCD1_DADDR = rxbufr;
+                DMA_TCD1_DOFF = rxoff;
+                DMA_TCD1_CITER_ELINKNO = n;
+                DMA_TCD1_DLASTSGA = 0;
+                DMA_TCD1_BITER_ELINKNO = n;
+                DMA_TCD1_CSR = DMA_TCD_CSR_DREQ | DMA_TCD_CSR_INTMAJOR;
+
+                DMAMUX0_CHCFG0 = DMAMUX_DISABLE;
+                DMAMUX0_CHCFG1 = DMAMUX_DISABLE;
+                if(interval) {
+                        // The PIT triggers the always-enabled source
+                        SIM_SCGC6 |= SIM_SCGC6_PIT;
+                        PIT_MCR = 0;
+                        PIT_TCTRL0 = 0;
+                        PIT_LDVAL0 = (delay ? delay : interval) * (F_BUS_ACTUAL / 1000000) - 1;
+                        DMAMUX0_CHCFG0 = DMAMUX_SOURCE_ALWAYS0 | DMAMUX_TRIG | DMAMUX_ENABLE;
+                        SPI0_RSER = SPI_RSER_RFDF_RE | SPI_RSER_RFDF_DIRS;
+                } else {
+                        DMAMUX0_CHCFG0 = DMAMUX_SOURCE_SPI0_TX | DMAMUX_ENABLE;
+                        SPI0_RSER = SPI_RSER_TFFF_RE | SPI_RSER_TFFF_DIRS | SPI_RSER_RFDF_RE | SPI_RSER_RFDF_DIRS;
+                }
+                DMAMUX0_CHCFG1 = DMAMUX_SOURCE_SPI0_RX | DMAMUX_ENABLE;
+
+                NVIC_ENABLE_IRQ(IRQ_DMA_CH1);
+                DMA_SERQ = 1;
+                DMA_SERQ = 0;
+                if(interval) {
+                        // The interval is loaded when the first delay expires
+                        PIT_TCTRL0 = 1;
+                        PIT_LDVAL0 = interval * (F_BUS_ACTUAL / 1000000) - 1;
+                }
+        }
+
+        /**
+         * Send an array of bytes using DMA, returning immediately.
+         * The array must not be modified until the transfer is complete.
+         *
+         * @param bufr array of bytes to send
+         * @param n number of bytes to send [1-32767]
+         * @param callback function called from the interrupt when complete
+         * @param interval microseconds before each byte, 0 to send without delay
+         */
+        void dmaSend(const void *bufr, size_t n, void (*callback)(), uint16_t interval) {
+                dmaStart(bufr, 1, &dmaDiscard, 0, n, callback, interval, 0);
+        }
+
+        /**
+         * Receive multiple bytes from SPI using DMA, returning immediately.
+         *
+         * @param bufr array that stores bytes from SPI.
+         * @param n number of bytes to receive [1-32767]
+         * @param callback function called from the interrupt when complete
+         * @param interval microseconds between bytes, 0 to receive without delay
+         * @param delay microseconds before the first byte, 0 for interval
+         */
+        void dmaReceive(void *bufr, size_t n, void (*callback)(), uint16_t interval, uint16_t delay) {
+                dmaStart(&dmaFill, 0, bufr, 1, n, callback, interval, delay);
+        }
+
+        /**
+         * @return true while a DMA transfer is in progress
+         */
+        bool dmaBusy() {
+                return dmaActive;
+        }
+
+        /**
+         * Sleep until the DMA transfer in progress, if any, is complete.
+         */
+        void dmaWait() {
+                while(dmaActive) {
+                        asm volatile("wfi");
+                }
+        }
+
+        /**
+         * End the DMA transfer.
+         * This function is only used internally.
+         */
+        void dmaComplete() {
+                PIT_TCTRL0 = 0;
+                SPI0_RSER = 0;
+                DMA_CERQ = 0;
+                DMAMUX0_CHCFG0 = DMAMUX_DISABLE;
+                DMAMUX0_CHCFG1 = DMAMUX_DISABLE;
+                dmaActive = false;
+                if(dmaCallback) {
+                        dmaCallback();
+                }
+        }
+}
+
+void dma_ch1_isr(void) {
+        DMA_CINT = 1;
+        spi4teensy3::dmaComplete();
 }
 #endif
@@ -28,15 +28,32 @@
 #define SPI4TEENSY3_MODE_3 1, 1
 #define MODE_TO_SPI4TEENSY3_MODE(x) (x & 1), (x&2)
 
+/*
+ * The DMA transfers (dmaSend, dmaReceive) use fixed hardware:
+ *   DMA channel 0 and 1, together with their DMAMUX slots and the
+ *   dma_ch1_isr interrupt handler;
+ *   PIT channel 0 to pace the bytes when an interval is given.
+ * Nothing else may use these while a transfer is in progress.  In
+ * particular IntervalTimer allocates PIT channels from 0 upwards, so it
+ * must not be used (e.g. the i2c_t3 debug timer) unless channel 0 is
+ * taken before the first paced transfer.
+ */
+
 namespace spi4teensy3 {
         void init();
         void init(uint8_t speed);
         void init(uint8_t cpol, uint8_t cpha);
         void init(uint8_t speed, uint8_t cpol, uint8_t cpha);
+        uint8_t speed(uint32_t hz);
+        uint32_t sclk(uint8_t speed);
         void send(uint8_t b);
         void send(void *bufr, size_t n);
         uint8_t receive();
         void receive(void *bufr, size_t n);
+        void dmaSend(const void *bufr, size_t n, void (*callback)(), uint16_t interval = 0);
+        void dmaReceive(void *bufr, size_t n, void (*callback)(), uint16_t interval = 0, uint16_t delay = 0);
+        bool dmaBusy();
+        void dmaWait();
 
         //void updatectars();
 };
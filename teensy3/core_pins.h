@@ -758,6 +758,11 @@ void delay(uint32_t msec);
 
 extern volatile uint32_t systick_millis_count;
 
+// the core and bus clocks currently running, F_CPU and F_BUS unless changed
+// at run time, e.g. by the low-power library
+extern volatile uint32_t F_CPU_ACTUAL;
+extern volatile uint32_t F_BUS_ACTUAL;
+
 static inline uint32_t millis(void) __attribute__((always_inline, unused));
 static inline uint32_t millis(void)
 {
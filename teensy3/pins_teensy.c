@@ -650,11 +650,16 @@ uint8_t shiftIn_msbFirst(uint8_t dataPin, uint8_t clockPin)
 // the systick interrupt is supposed to increment this at 1 kHz rate
 volatile uint32_t systick_millis_count = 0;
 
+// the core and bus clocks currently running, which may be changed at run time
+volatile uint32_t F_CPU_ACTUAL = F_CPU;
+volatile uint32_t F_BUS_ACTUAL = F_BUS;
+
 //uint32_t systick_current, systick_count, systick_istatus;  // testing only
 
 uint32_t micros(void)
 {
 	uint32_t count, current, istatus;
+	const uint32_t cpu = F_CPU_ACTUAL;
 
 	__disable_irq();
 	current = SYST_CVR;
@@ -665,8 +670,8 @@ uint32_t micros(void)
 	 //systick_count = count;
 	 //systick_istatus = istatus & SCB_ICSR_PENDSTSET ? 1 : 0;
 	if ((istatus & SCB_ICSR_PENDSTSET) && current > 50) count++;
-	current = ((F_CPU / 1000) - 1) - current;
-	return count * 1000 + current / (F_CPU / 1000000);
+	current = ((cpu / 1000) - 1) - current;
+	return count * 1000 + current / (cpu / 1000000);
 }
 
 void delay(uint32_t ms)
@@ -83,7 +83,11 @@ static uint8_t device_descriptor[] = {
         EP0_SIZE,                               // bMaxPacketSize0
         LSB(VENDOR_ID), MSB(VENDOR_ID),         // idVendor
         LSB(PRODUCT_ID), MSB(PRODUCT_ID),       // idProduct
+#ifdef BCD_DEVICE
+        LSB(BCD_DEVICE), MSB(BCD_DEVICE),       // bcdDevice
+#else
         0x00, 0x01,                             // bcdDevice
+#endif
         1,                                      // iManufacturer
         2,                                      // iProduct
         3,                                      // iSerialNumber
@@ -193,6 +193,57 @@ let me know?  http://forum.pjrc.com/forums/4-Suggestions-amp-Bug-Reports
   #define ENDPOINT5_CONFIG	ENDPOINT_TRANSIMIT_ONLY
   #define ENDPOINT6_CONFIG	ENDPOINT_TRANSIMIT_ONLY
 
+#elif defined(USB_SERIAL_KEYBOARD_MOUSE)
+  // USB_SERIAL_HID without the joystick interface, with 1ms polling of the
+  // keyboard and mouse and a buffer pool sized for the remaining endpoints:
+  //   CDC RX     2 (BDT even/odd) + 2 queued                   =  4
+  //   CDC TX     2 (BDT even/odd) + CDC_TX_PACKET_LIMIT + 1    =  7
+  //   Keyboard   2 (BDT even/odd) + KEYBOARD_TX_PACKET_LIMIT   =  4
+  //   Mouse      2 (BDT even/odd) + MOUSE_TX_PACKET_LIMIT      =  4
+  //   Spare                                                    =  1
+  #define VENDOR_ID		0x16C0
+  #define PRODUCT_ID		0x0487
+  #define BCD_DEVICE		0x0101
+  #define DEVICE_CLASS		0xEF
+  #define DEVICE_SUBCLASS	0x02
+  #define DEVICE_PROTOCOL	0x01
+  #define MANUFACTURER_NAME	{'T','e','e','n','s','y','d','u','i','n','o'}
+  #define MANUFACTURER_NAME_LEN	11
+  #define PRODUCT_NAME		{'S','e','r','i','a','l','/','K','e','y','b','o','a','r','d','/','M','o','u','s','e'}
+  #define PRODUCT_NAME_LEN	21
+  #define EP0_SIZE		64
+  #define NUM_ENDPOINTS		5
+  #define NUM_USB_BUFFERS	20
+  #define NUM_INTERFACE		4
+  #define CDC_IAD_DESCRIPTOR	1
+  #define CDC_STATUS_INTERFACE	0
+  #define CDC_DATA_INTERFACE	1	// Serial
+  #define CDC_ACM_ENDPOINT	2
+  #define CDC_RX_ENDPOINT       3
+  #define CDC_TX_ENDPOINT       4
+  #define CDC_ACM_SIZE          16
+  #define CDC_RX_SIZE           64
+  #define CDC_TX_SIZE           64
+  #define CDC_TX_PACKET_LIMIT   4
+  #define KEYBOARD_INTERFACE    2	// Keyboard
+  #define KEYBOARD_ENDPOINT     1
+  #define KEYBOARD_SIZE         8
+  #define KEYBOARD_INTERVAL     1
+  #define KEYBOARD_TX_PACKET_LIMIT 2
+  #define MOUSE_INTERFACE       3	// Mouse
+  #define MOUSE_ENDPOINT        5
+  #define MOUSE_SIZE            8
+  #define MOUSE_INTERVAL        1
+  #define MOUSE_TX_PACKET_LIMIT 2
+  #define KEYBOARD_DESC_OFFSET	(9+8 + 9+5+5+4+5+7+9+7+7 + 9)
+  #define MOUSE_DESC_OFFSET	(9+8 + 9+5+5+4+5+7+9+7+7 + 9+9+7 + 9)
+  #define CONFIG_DESC_SIZE	(9+8 + 9+5+5+4+5+7+9+7+7 + 9+9+7 + 9+9+7)
+  #define ENDPOINT1_CONFIG	ENDPOINT_TRANSIMIT_ONLY
+  #define ENDPOINT2_CONFIG	ENDPOINT_TRANSIMIT_ONLY
+  #define ENDPOINT3_CONFIG	ENDPOINT_RECEIVE_ONLY
+  #define ENDPOINT4_CONFIG	ENDPOINT_TRANSIMIT_ONLY
+  #define ENDPOINT5_CONFIG	ENDPOINT_TRANSIMIT_ONLY
+
 #elif defined(USB_MIDI)
   #define VENDOR_ID		0x16C0
   #define PRODUCT_ID		0x0485
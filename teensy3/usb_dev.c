@@ -32,6 +32,7 @@
 //#include "HardwareSerial.h"
 #include "usb_dev.h"
 #include "usb_mem.h"
+#include "core_pins.h" // for micros()
 
 // buffer descriptor table
 
@@ -48,6 +49,20 @@ static usb_packet_t *rx_last[NUM_ENDPOINTS];
 static usb_packet_t *tx_first[NUM_ENDPOINTS];
 static usb_packet_t *tx_last[NUM_ENDPOINTS];
 uint16_t usb_rx_byte_count_data[NUM_ENDPOINTS];
+uint8_t usb_tx_packet_high_water[NUM_ENDPOINTS];
+
+// micros() and count at the last start-of-frame
+volatile uint32_t usb_sof_time = 0;
+volatile uint32_t usb_sof_count = 0;
+
+// set when resume signalling is detected while usb_resume_detect() is enabled
+volatile uint8_t usb_resumed = 0;
+
+// latency from queueing each transmit packet to the host reading it,
+// in microseconds, indexed by endpoint-1
+uint32_t usb_tx_latency_sum[NUM_ENDPOINTS];
+uint32_t usb_tx_latency_count[NUM_ENDPOINTS];
+uint16_t usb_tx_latency_max[NUM_ENDPOINTS];
 
 static uint8_t tx_state[NUM_ENDPOINTS];
 #define TX_STATE_BOTH_FREE_EVEN_FIRST	0
@@ -78,6 +93,25 @@ static uint8_t tx_state[NUM_ENDPOINTS];
 #define stat2bufferdescriptor(stat) (table + ((stat) >> 2))
 
 
+// Same as micros(), but restores the interrupt mask instead of enabling
+// interrupts, so it may be called inside a critical section.
+static uint32_t usb_micros(void)
+{
+	uint32_t count, current, istatus, primask;
+	const uint32_t cpu = F_CPU_ACTUAL;
+
+	__asm__ volatile("mrs %0, primask\n" : "=r" (primask)::);
+	__disable_irq();
+	current = SYST_CVR;
+	count = systick_millis_count;
+	istatus = SCB_ICSR;	// bit 26 indicates if systick exception pending
+	if (!primask) __enable_irq();
+	if ((istatus & SCB_ICSR_PENDSTSET) && current > 50) count++;
+	current = ((cpu / 1000) - 1) - current;
+	return count * 1000 + current / (cpu / 1000000);
+}
+
+
 static union {
  struct {
   union {
@@ -587,6 +621,40 @@ uint32_t usb_tx_packet_count(uint32_t endpoint)
 	return count;
 }
 
+// number of transmit packets the USB hardware owns in the state
+#define TX_STATE_BDT_COUNT(state) ((state) >> 1)
+
+uint32_t usb_tx_packet_pending(uint32_t endpoint)
+{
+	const usb_packet_t *p;
+	uint32_t count;
+
+	endpoint--;
+	if (endpoint >= NUM_ENDPOINTS) return 0;
+	__disable_irq();
+	count = TX_STATE_BDT_COUNT(tx_state[endpoint]);
+	for (p = tx_first[endpoint]; p; p = p->next) count++;
+	__enable_irq();
+	return count;
+}
+
+
+// Return the last packet queued on the endpoint which has not yet been given
+// to the USB hardware, or NULL if there is none.  Must be called with
+// interrupts disabled, and the packet may only be modified before they are
+// re-enabled, after which it may be handed to the hardware at any time.
+// The packet is restamped as its contents are expected to be replaced.
+usb_packet_t *usb_tx_pending(uint32_t endpoint)
+{
+	usb_packet_t *packet;
+
+	endpoint--;
+	if (endpoint >= NUM_ENDPOINTS) return NULL;
+	packet = tx_first[endpoint] ? tx_last[endpoint] : NULL;
+	if (packet) packet->index = usb_micros();
+	return packet;
+}
+
 
 // Called from usb_free, but only when usb_rx_memory_needed > 0, indicating
 // receive endpoints are starving for memory.  The intention is to give
@@ -645,6 +713,9 @@ void usb_tx(uint32_t endpoint, usb_packet_t *packet)
 
 	endpoint--;
 	if (endpoint >= NUM_ENDPOINTS) return;
+	// the index of a transmit packet is not otherwise used, so holds the
+	// low 16 bits of micros() when queued for the latency statistics
+	packet->index = usb_micros();
 	__disable_irq();
 	//serial_print("txstate=");
 	//serial_phex(tx_state[endpoint]);
@@ -671,12 +742,24 @@ void usb_tx(uint32_t endpoint, usb_packet_t *packet)
 			tx_last[endpoint]->next = packet;
 		}
 		tx_last[endpoint] = packet;
+		{
+			const usb_packet_t *p;
+			uint8_t count = TX_STATE_BDT_COUNT(tx_state[endpoint]);
+			for (p = tx_first[endpoint]; p; p = p->next) count++;
+			if (count > usb_tx_packet_high_water[endpoint]) {
+				usb_tx_packet_high_water[endpoint] = count;
+			}
+		}
 		__enable_irq();
 		return;
 	}
 	tx_state[endpoint] = next;
 	b->addr = packet->buf;
 	b->desc = BDT_DESC(packet->len, ((uint32_t)b & 8) ? DATA1 : DATA0);
+	// the software queue is empty while a buffer descriptor is free
+	if (TX_STATE_BDT_COUNT(next) > usb_tx_packet_high_water[endpoint]) {
+		usb_tx_packet_high_water[endpoint] = TX_STATE_BDT_COUNT(next);
+	}
 	__enable_irq();
 }
 
@@ -693,10 +776,44 @@ void _reboot_Teensyduino_(void)
 
 
 
+// Enable or disable the asynchronous resume interrupt, which detects resume
+// signalling while the USB module clock is stopped, e.g. at a reduced CPU
+// clock, and sets usb_resumed.  The module registers fault while its clock
+// is gated off, so enable before stopping the clock and disable after
+// restarting it.
+void usb_resume_detect(uint8_t enable)
+{
+	__disable_irq();
+	usb_resumed = 0;
+	if (enable) {
+		USB0_USBTRC0 |= USB_USBTRC_USBRESMEN;
+	} else {
+		USB0_USBTRC0 &= ~USB_USBTRC_USBRESMEN;
+		NVIC_ENABLE_IRQ(IRQ_USBOTG);
+	}
+	__enable_irq();
+}
+
+
 void usb_isr(void)
 {
 	uint8_t status, stat, t;
 
+	// with the module clock gated off only the asynchronous resume interrupt
+	// can be asserted and no register may be read, so mask it until
+	// usb_resume_detect(0) once the clock is restarted
+	if (!(SIM_SCGC4 & SIM_SCGC4_USBOTG)) {
+		usb_resumed = 1;
+		NVIC_DISABLE_IRQ(IRQ_USBOTG);
+		return;
+	}
+
+	// the asynchronous resume interrupt is asserted until it is disabled
+	if (USB0_USBTRC0 & USB_USBTRC_USB_RESUME_INT) {
+		USB0_USBTRC0 &= ~USB_USBTRC_USBRESMEN;
+		usb_resumed = 1;
+	}
+
 	//serial_print("isr");
 	//status = USB0_ISTAT;
 	//serial_phex(status);
@@ -705,6 +822,8 @@ void usb_isr(void)
 	status = USB0_ISTAT;
 
 	if ((status & USB_INTEN_SOFTOKEN /* 04 */ )) {
+		usb_sof_time = usb_micros();
+		usb_sof_count++;
 		if (usb_configuration) {
 			t = usb_reboot_timer;
 			if (t) {
@@ -761,6 +880,12 @@ void usb_isr(void)
 			endpoint--;	// endpoint is index to zero-based arrays
 
 			if (stat & 0x08) { // transmit
+				uint16_t latency = (uint16_t)usb_micros() - packet->index;
+				usb_tx_latency_sum[endpoint] += latency;
+				usb_tx_latency_count[endpoint]++;
+				if (latency > usb_tx_latency_max[endpoint]) {
+					usb_tx_latency_max[endpoint] = latency;
+				}
 				usb_free(packet);
 				packet = tx_first[endpoint];
 				if (packet) {
@@ -49,11 +49,31 @@ void usb_isr(void);
 usb_packet_t *usb_rx(uint32_t endpoint);
 uint32_t usb_tx_byte_count(uint32_t endpoint);
 uint32_t usb_tx_packet_count(uint32_t endpoint);
+uint32_t usb_tx_packet_pending(uint32_t endpoint);
 void usb_tx(uint32_t endpoint, usb_packet_t *packet);
+usb_packet_t *usb_tx_pending(uint32_t endpoint);
 void usb_tx_isr(uint32_t endpoint, usb_packet_t *packet);
+void usb_resume_detect(uint8_t enable);
 
 extern volatile uint8_t usb_configuration;
 
+// maximum number of transmit packets pending on each endpoint, both queued
+// and owned by the USB hardware, indexed by endpoint-1
+extern uint8_t usb_tx_packet_high_water[NUM_ENDPOINTS];
+
+// micros() and count at the last start-of-frame
+extern volatile uint32_t usb_sof_time;
+extern volatile uint32_t usb_sof_count;
+
+// set when resume signalling is detected while usb_resume_detect() is enabled
+extern volatile uint8_t usb_resumed;
+
+// latency from queueing each transmit packet to the host reading it,
+// in microseconds, indexed by endpoint-1
+extern uint32_t usb_tx_latency_sum[NUM_ENDPOINTS];
+extern uint32_t usb_tx_latency_count[NUM_ENDPOINTS];
+extern uint16_t usb_tx_latency_max[NUM_ENDPOINTS];
+
 extern uint16_t usb_rx_byte_count_data[NUM_ENDPOINTS];
 static inline uint32_t usb_rx_byte_count(uint32_t endpoint) __attribute__((always_inline));
 static inline uint32_t usb_rx_byte_count(uint32_t endpoint)
@@ -50,6 +50,12 @@ usb_joystick_class Joystick;
 uint8_t usb_joystick_class::manual_mode = 0;
 #endif
 
+#ifdef USB_SERIAL_KEYBOARD_MOUSE
+usb_serial_class Serial;
+usb_keyboard_class Keyboard;
+usb_mouse_class Mouse;
+#endif
+
 #ifdef USB_MIDI
 usb_midi_class usbMIDI;
 usb_seremu_class Serial;
@@ -48,20 +48,12 @@ static uint8_t transmit_previous_timeout=0;
 // When the PC isn't listening, how long do we wait before discarding data?
 #define TX_TIMEOUT_MSEC 30
 
-#if F_CPU == 96000000
-  #define TX_TIMEOUT (TX_TIMEOUT_MSEC * 596)
-#elif F_CPU == 48000000
-  #define TX_TIMEOUT (TX_TIMEOUT_MSEC * 428)
-#elif F_CPU == 24000000
-  #define TX_TIMEOUT (TX_TIMEOUT_MSEC * 262)
-#endif
-
 
 
 
 int usb_joystick_send(void)
 {
-        uint32_t wait_count=0;
+        uint32_t wait_begin_at=millis();
         usb_packet_t *tx_packet;
 
 	//serial_print("send");
@@ -75,7 +67,7 @@ int usb_joystick_send(void)
                         tx_packet = usb_malloc();
                         if (tx_packet) break;
                 }
-                if (++wait_count > TX_TIMEOUT || transmit_previous_timeout) {
+                if (millis() - wait_begin_at > TX_TIMEOUT_MSEC || transmit_previous_timeout) {
                         transmit_previous_timeout = 1;
 			//serial_print("error2\n");
                         return -1;
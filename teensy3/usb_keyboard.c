@@ -442,20 +442,35 @@ int usb_keyboard_press(uint8_t key, uint8_t modifier)
 
 
 // Maximum number of transmit packets to queue so we don't starve other endpoints for memory
+#ifdef KEYBOARD_TX_PACKET_LIMIT
+#define TX_PACKET_LIMIT KEYBOARD_TX_PACKET_LIMIT
+#else
 #define TX_PACKET_LIMIT 4
+#endif
 
 static uint8_t transmit_previous_timeout=0;
 
+// number of reports discarded because the host was not accepting data
+uint32_t usb_keyboard_tx_timeout_count=0;
+
+// number of queued reports replaced by a newer state before transmission
+uint32_t usb_keyboard_tx_overwrite_count=0;
+
+// number of reports not sent because no packet was available
+uint32_t usb_keyboard_tx_busy_count=0;
+
 // When the PC isn't listening, how long do we wait before discarding data?
 #define TX_TIMEOUT_MSEC 50
 
-#if F_CPU == 96000000
-  #define TX_TIMEOUT (TX_TIMEOUT_MSEC * 596)
-#elif F_CPU == 48000000
-  #define TX_TIMEOUT (TX_TIMEOUT_MSEC * 428)
-#elif F_CPU == 24000000
-  #define TX_TIMEOUT (TX_TIMEOUT_MSEC * 262)
-#endif
+
+// fill the packet with the contents of keyboard_keys and keyboard_modifier_keys
+static void usb_keyboard_report(usb_packet_t *tx_packet)
+{
+	*(tx_packet->buf) = keyboard_modifier_keys;
+	*(tx_packet->buf + 1) = keyboard_media_keys;
+	memcpy(tx_packet->buf + 2, keyboard_keys, 6);
+	tx_packet->len = 8;
+}
 
 
 // send the contents of keyboard_keys and keyboard_modifier_keys
@@ -473,7 +488,7 @@ int usb_keyboard_send(void)
 	serial_print("\n");
 #endif
 #if 1
-	uint32_t wait_count=0;
+	uint32_t wait_begin_at=millis();
 	usb_packet_t *tx_packet;
 
 	while (1) {
@@ -484,20 +499,50 @@ int usb_keyboard_send(void)
 			tx_packet = usb_malloc();
 			if (tx_packet) break;
 		}
-		if (++wait_count > TX_TIMEOUT || transmit_previous_timeout) {
+		if (millis() - wait_begin_at > TX_TIMEOUT_MSEC || transmit_previous_timeout) {
 			transmit_previous_timeout = 1;
+			usb_keyboard_tx_timeout_count++;
 			return -1;
 		}
 		yield();
 	}
-	*(tx_packet->buf) = keyboard_modifier_keys;
-	*(tx_packet->buf + 1) = keyboard_media_keys;
-	memcpy(tx_packet->buf + 2, keyboard_keys, 6);
-	tx_packet->len = 8;
+	usb_keyboard_report(tx_packet);
 	usb_tx(KEYBOARD_ENDPOINT, tx_packet);
 #endif
 	return 0;
 }
 
 
+// send the contents of keyboard_keys and keyboard_modifier_keys without
+// waiting.  A new report is queued if the queue is not full, so short key
+// taps are not lost, otherwise the last report still queued for transmission
+// is overwritten in place with the latest state.  0 returned if the current
+// state will be sent, -1 if not, in which case the caller should try again
+int usb_keyboard_send_latest(void)
+{
+	usb_packet_t *tx_packet;
+
+	if (!usb_configuration) return -1;
+	if (usb_tx_packet_count(KEYBOARD_ENDPOINT) < TX_PACKET_LIMIT) {
+		tx_packet = usb_malloc();
+		if (tx_packet) {
+			usb_keyboard_report(tx_packet);
+			usb_tx(KEYBOARD_ENDPOINT, tx_packet);
+			return 0;
+		}
+	}
+	__disable_irq();
+	tx_packet = usb_tx_pending(KEYBOARD_ENDPOINT);
+	if (tx_packet) {
+		usb_keyboard_report(tx_packet);
+		usb_keyboard_tx_overwrite_count++;
+		__enable_irq();
+		return 0;
+	}
+	__enable_irq();
+	usb_keyboard_tx_busy_count++;
+	return -1;
+}
+
+
 #endif // KEYBOARD_INTERFACE
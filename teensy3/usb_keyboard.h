@@ -33,7 +33,7 @@
 
 #include "keylayouts.h"
 
-#if defined(USB_HID) || defined(USB_SERIAL_HID)
+#if defined(USB_HID) || defined(USB_SERIAL_HID) || defined(USB_SERIAL_KEYBOARD_MOUSE)
 
 #include <inttypes.h>
 
@@ -48,6 +48,10 @@ void usb_keyboard_release_keycode(uint16_t n);
 void usb_keyboard_release_all(void);
 int usb_keyboard_press(uint8_t key, uint8_t modifier);
 int usb_keyboard_send(void);
+int usb_keyboard_send_latest(void);
+extern uint32_t usb_keyboard_tx_timeout_count;
+extern uint32_t usb_keyboard_tx_overwrite_count;
+extern uint32_t usb_keyboard_tx_busy_count;
 extern uint8_t keyboard_modifier_keys;
 extern uint8_t keyboard_media_keys;
 extern uint8_t keyboard_keys[6];
@@ -85,6 +89,7 @@ public:
 	void set_key6(uint8_t c) { keyboard_keys[5] = c; }
 	void set_media(uint8_t c) { keyboard_media_keys = c; }
 	void send_now(void) { usb_keyboard_send(); }
+	bool send_latest(void) { return usb_keyboard_send_latest() == 0; }
 	void press(uint16_t n) { usb_keyboard_press_keycode(n); }
 	void release(uint16_t n) { usb_keyboard_release_keycode(n); }
 	void releaseAll(void) { usb_keyboard_release_all(); }
@@ -94,5 +99,5 @@ extern usb_keyboard_class Keyboard;
 
 #endif // __cplusplus
 
-#endif // USB_HID || USB_SERIAL_HID
+#endif // USB_HID || USB_SERIAL_HID || USB_SERIAL_KEYBOARD_MOUSE
 #endif // USBkeyboard_h_
@@ -38,6 +38,13 @@ unsigned char usb_buffer_memory[NUM_USB_BUFFERS * sizeof(usb_packet_t)];
 
 static uint32_t usb_buffer_available = 0xFFFFFFFF;
 
+// packet pool statistics, used to size NUM_USB_BUFFERS and to check
+// that no endpoint is starved of memory
+uint32_t usb_malloc_count = 0;
+uint32_t usb_malloc_fail_count = 0;
+uint8_t usb_buffer_used = 0;
+uint8_t usb_buffer_high_water = 0;
+
 // use bitmask and CLZ instruction to implement fast free list
 // http://www.archivum.info/gnu.gcc.help/2006-08/00148/Re-GCC-Inline-Assembly.html
 // http://gcc.gnu.org/ml/gcc/2012-06/msg00015.html
@@ -52,6 +59,7 @@ usb_packet_t * usb_malloc(void)
 	avail = usb_buffer_available;
 	n = __builtin_clz(avail); // clz = count leading zeros
 	if (n >= NUM_USB_BUFFERS) {
+		usb_malloc_fail_count++;
 		__enable_irq();
 		return NULL;
 	}
@@ -60,6 +68,10 @@ usb_packet_t * usb_malloc(void)
 	//serial_print("\n");
 
 	usb_buffer_available = avail & ~(0x80000000 >> n);
+	usb_malloc_count++;
+	if (++usb_buffer_used > usb_buffer_high_water) {
+		usb_buffer_high_water = usb_buffer_used;
+	}
 	__enable_irq();
 	p = usb_buffer_memory + (n * sizeof(usb_packet_t));
 	//serial_print("malloc:");
@@ -97,6 +109,7 @@ void usb_free(usb_packet_t *p)
 	mask = (0x80000000 >> n);
 	__disable_irq();
 	usb_buffer_available |= mask;
+	usb_buffer_used--;
 	__enable_irq();
 
 	//serial_print("free:");
@@ -47,6 +47,11 @@ extern "C" {
 usb_packet_t * usb_malloc(void);
 void usb_free(usb_packet_t *p);
 
+extern uint32_t usb_malloc_count;
+extern uint32_t usb_malloc_fail_count;
+extern uint8_t usb_buffer_used;
+extern uint8_t usb_buffer_high_water;
+
 #ifdef __cplusplus
 }
 #endif
@@ -62,18 +62,10 @@ static uint8_t tx_noautoflush=0;
 // When the PC isn't listening, how long do we wait before discarding data?
 #define TX_TIMEOUT_MSEC 40
 
-#if F_CPU == 96000000
-  #define TX_TIMEOUT (TX_TIMEOUT_MSEC * 596)
-#elif F_CPU == 48000000
-  #define TX_TIMEOUT (TX_TIMEOUT_MSEC * 428)
-#elif F_CPU == 24000000
-  #define TX_TIMEOUT (TX_TIMEOUT_MSEC * 262)
-#endif
-
 
 void usb_midi_write_packed(uint32_t n)
 {
-	uint32_t index, wait_count=0;
+	uint32_t index, wait_begin_at=millis();
 
 	tx_noautoflush = 1;
 	if (!tx_packet) {
@@ -86,7 +78,7 @@ void usb_midi_write_packed(uint32_t n)
                         	tx_packet = usb_malloc();
                         	if (tx_packet) break;
                 	}
-                	if (++wait_count > TX_TIMEOUT || transmit_previous_timeout) {
+                	if (millis() - wait_begin_at > TX_TIMEOUT_MSEC || transmit_previous_timeout) {
                         	transmit_previous_timeout = 1;
 				//serial_print("error2\n");
                         	return;
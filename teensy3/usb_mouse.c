@@ -107,32 +107,35 @@ int usb_mouse_buttons(uint8_t left, uint8_t middle, uint8_t right)
 
 
 // Maximum number of transmit packets to queue so we don't starve other endpoints for memory
+#ifdef MOUSE_TX_PACKET_LIMIT
+#define TX_PACKET_LIMIT MOUSE_TX_PACKET_LIMIT
+#else
 #define TX_PACKET_LIMIT 3
+#endif
 
 static uint8_t transmit_previous_timeout=0;
 
+// number of reports discarded because the host was not accepting data
+uint32_t usb_mouse_tx_timeout_count=0;
+
+// number of queued reports replaced by a newer state before transmission
+uint32_t usb_mouse_tx_overwrite_count=0;
+
+// number of reports not sent because no packet was available
+uint32_t usb_mouse_tx_busy_count=0;
+
+// wheel movement not yet sent by usb_mouse_move_latest
+static int8_t usb_mouse_wheel_pending=0;
+
 // When the PC isn't listening, how long do we wait before discarding data?
 #define TX_TIMEOUT_MSEC 30
 
-#if F_CPU == 96000000
-  #define TX_TIMEOUT (TX_TIMEOUT_MSEC * 596)
-#elif F_CPU == 48000000
-  #define TX_TIMEOUT (TX_TIMEOUT_MSEC * 428)
-#elif F_CPU == 24000000
-  #define TX_TIMEOUT (TX_TIMEOUT_MSEC * 262)
-#endif
-
 
-// Move the mouse.  x, y and wheel are -127 to 127.  Use 0 for no movement.
-int usb_mouse_move(int8_t x, int8_t y, int8_t wheel)
+// Update the absolute position from the relative movement
+static void usb_mouse_update_position(int8_t x, int8_t y)
 {
-        uint32_t wait_count=0, val32;
-        usb_packet_t *tx_packet;
 	uint16_t newval;
 
-        if (x == -128) x = -127;
-        if (y == -128) y = -127;
-        if (wheel == -128) wheel = -127;
 	if (x > 0) {
 		newval = usb_mouse_position_x + x;
 		if (newval >= usb_mouse_resolution_x) newval = usb_mouse_resolution_x - 1;
@@ -151,21 +154,14 @@ int usb_mouse_move(int8_t x, int8_t y, int8_t wheel)
 		if (newval & 0x8000) newval = 0;
 		usb_mouse_position_y = newval;
 	}
-        while (1) {
-                if (!usb_configuration) {
-                        return -1;
-                }
-                if (usb_tx_packet_count(MOUSE_ENDPOINT) < TX_PACKET_LIMIT) {
-                        tx_packet = usb_malloc();
-                        if (tx_packet) break;
-                }
-                if (++wait_count > TX_TIMEOUT || transmit_previous_timeout) {
-                        transmit_previous_timeout = 1;
-                        return -1;
-                }
-                yield();
-        }
-	transmit_previous_timeout = 0;
+}
+
+
+// Fill the packet with the buttons, current position and wheel
+static void usb_mouse_report(usb_packet_t *tx_packet, int8_t wheel)
+{
+	uint32_t val32;
+
 	*(tx_packet->buf) = usb_mouse_buttons_state;
 	val32 = usb_mouse_position_x * usb_mouse_scale_x + usb_mouse_offset_x;
 	 //serial_print("move:");
@@ -184,10 +180,98 @@ int usb_mouse_move(int8_t x, int8_t y, int8_t wheel)
 	*(tx_packet->buf + 4) = val32 >> 24;
 	*(tx_packet->buf + 5) = wheel;
 	tx_packet->len = 6;
+}
+
+
+// Move the mouse.  x, y and wheel are -127 to 127.  Use 0 for no movement.
+int usb_mouse_move(int8_t x, int8_t y, int8_t wheel)
+{
+        uint32_t wait_begin_at=millis();
+        usb_packet_t *tx_packet;
+
+        if (x == -128) x = -127;
+        if (y == -128) y = -127;
+        if (wheel == -128) wheel = -127;
+	usb_mouse_update_position(x, y);
+        while (1) {
+                if (!usb_configuration) {
+                        return -1;
+                }
+                if (usb_tx_packet_count(MOUSE_ENDPOINT) < TX_PACKET_LIMIT) {
+                        tx_packet = usb_malloc();
+                        if (tx_packet) break;
+                }
+                if (millis() - wait_begin_at > TX_TIMEOUT_MSEC || transmit_previous_timeout) {
+                        transmit_previous_timeout = 1;
+                        usb_mouse_tx_timeout_count++;
+                        return -1;
+                }
+                yield();
+        }
+	transmit_previous_timeout = 0;
+	usb_mouse_report(tx_packet, wheel);
 	usb_tx(MOUSE_ENDPOINT, tx_packet);
         return 0;
 }
 
+
+// Move the mouse without waiting.  The position is absolute so only the
+// latest needs to reach the host: a report still queued for transmission
+// with the same buttons is overwritten in place and the wheel movement
+// accumulated, otherwise a new report is queued if a packet is available.
+// Wheel movement which cannot be sent is kept for the next report.
+// 0 returned if the current state will be sent, -1 if not, in which case
+// the caller should try again later
+int usb_mouse_move_latest(int8_t x, int8_t y, int8_t wheel)
+{
+	usb_packet_t *tx_packet;
+	int16_t sum;
+
+	if (x == -128) x = -127;
+	if (y == -128) y = -127;
+	usb_mouse_update_position(x, y);
+	sum = usb_mouse_wheel_pending + wheel;
+	if (sum > 127) sum = 127;
+	if (sum < -127) sum = -127;
+	usb_mouse_wheel_pending = sum;
+	if (!usb_configuration) return -1;
+	__disable_irq();
+	tx_packet = usb_tx_pending(MOUSE_ENDPOINT);
+	if (tx_packet && *(tx_packet->buf) == usb_mouse_buttons_state) {
+		sum += (int8_t)*(tx_packet->buf + 5);
+		if (sum <= 127 && sum >= -127) {
+			usb_mouse_report(tx_packet, sum);
+			usb_mouse_wheel_pending = 0;
+			usb_mouse_tx_overwrite_count++;
+			__enable_irq();
+			return 0;
+		}
+	}
+	__enable_irq();
+	if (usb_tx_packet_count(MOUSE_ENDPOINT) >= TX_PACKET_LIMIT
+	  || (tx_packet = usb_malloc()) == NULL) {
+		usb_mouse_tx_busy_count++;
+		return -1;
+	}
+	usb_mouse_report(tx_packet, usb_mouse_wheel_pending);
+	usb_mouse_wheel_pending = 0;
+	usb_tx(MOUSE_ENDPOINT, tx_packet);
+	return 0;
+}
+
+
+// Set the mouse buttons without waiting, see usb_mouse_move_latest
+int usb_mouse_buttons_latest(uint8_t left, uint8_t middle, uint8_t right)
+{
+        uint8_t mask=0;
+
+        if (left) mask |= 1;
+        if (middle) mask |= 4;
+        if (right) mask |= 2;
+        usb_mouse_buttons_state = mask;
+        return usb_mouse_move_latest(0, 0, 0);
+}
+
 int usb_mouse_position(uint16_t x, uint16_t y)
 {
 	if (x >= usb_mouse_resolution_x) x = usb_mouse_resolution_x - 1;
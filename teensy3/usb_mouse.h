@@ -31,7 +31,7 @@
 #ifndef USBmouse_h_
 #define USBmouse_h_
 
-#if defined(USB_HID) || defined(USB_SERIAL_HID)
+#if defined(USB_HID) || defined(USB_SERIAL_HID) || defined(USB_SERIAL_KEYBOARD_MOUSE)
 
 #include <inttypes.h>
 
@@ -41,9 +41,14 @@ extern "C" {
 #endif
 int usb_mouse_buttons(uint8_t left, uint8_t middle, uint8_t right);
 int usb_mouse_move(int8_t x, int8_t y, int8_t wheel);
+int usb_mouse_move_latest(int8_t x, int8_t y, int8_t wheel);
+int usb_mouse_buttons_latest(uint8_t left, uint8_t middle, uint8_t right);
 int usb_mouse_position(uint16_t x, uint16_t y);
 void usb_mouse_screen_size(uint16_t width, uint16_t height, uint8_t mac);
 extern uint8_t usb_mouse_buttons_state;
+extern uint32_t usb_mouse_tx_timeout_count;
+extern uint32_t usb_mouse_tx_overwrite_count;
+extern uint32_t usb_mouse_tx_busy_count;
 #ifdef __cplusplus
 }
 #endif
@@ -62,6 +67,9 @@ class usb_mouse_class
         void begin(void) { }
         void end(void) { }
         void move(int8_t x, int8_t y, int8_t wheel=0) { usb_mouse_move(x, y, wheel); }
+        bool move_latest(int8_t x, int8_t y, int8_t wheel=0) {
+		return usb_mouse_move_latest(x, y, wheel) == 0;
+	}
 	void moveTo(uint16_t x, uint16_t y) { usb_mouse_position(x, y); }
 	void screenSize(uint16_t width, uint16_t height, bool isMacintosh = false) {
 		usb_mouse_screen_size(width, height, isMacintosh ? 1 : 0);
@@ -76,6 +84,9 @@ class usb_mouse_class
         void set_buttons(uint8_t left, uint8_t middle=0, uint8_t right=0) {
 		usb_mouse_buttons(left, middle, right);
 	}
+        bool set_buttons_latest(uint8_t left, uint8_t middle=0, uint8_t right=0) {
+		return usb_mouse_buttons_latest(left, middle, right) == 0;
+	}
         void press(uint8_t b = MOUSE_LEFT) {
 		uint8_t buttons = usb_mouse_buttons_state | (b & MOUSE_ALL);
 		if (buttons != usb_mouse_buttons_state) {
@@ -98,5 +109,5 @@ extern usb_mouse_class Mouse;
 
 #endif // __cplusplus
 
-#endif // USB_HID || USB_SERIAL_HID
+#endif // USB_HID || USB_SERIAL_HID || USB_SERIAL_KEYBOARD_MOUSE
 #endif // USBmouse_h_
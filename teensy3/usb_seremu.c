@@ -138,14 +138,6 @@ void usb_seremu_flush_input(void)
 // software.  If it's too long, we stall the user's program when no software is running.
 #define TX_TIMEOUT_MSEC 30
 
-#if F_CPU == 96000000
-  #define TX_TIMEOUT (TX_TIMEOUT_MSEC * 596)
-#elif F_CPU == 48000000
-  #define TX_TIMEOUT (TX_TIMEOUT_MSEC * 428)
-#elif F_CPU == 24000000
-  #define TX_TIMEOUT (TX_TIMEOUT_MSEC * 262)
-#endif
-
 // When we've suffered the transmit timeout, don't wait again until the computer
 // begins accepting data.  If no software is running to receive, we'll just discard
 // data as rapidly as Serial.print() can generate it, until there's something to
@@ -164,14 +156,14 @@ int usb_seremu_write(const void *buffer, uint32_t size)
 {
 #if 1
 	uint32_t len;
-	uint32_t wait_count;
+	uint32_t wait_begin_at;
 	const uint8_t *src = (const uint8_t *)buffer;
 	uint8_t *dest;
 
 	tx_noautoflush = 1;
 	while (size > 0) {
 		if (!tx_packet) {
-			wait_count = 0;
+			wait_begin_at = millis();
 			while (1) {
 				if (!usb_configuration) {
 					tx_noautoflush = 0;
@@ -182,7 +174,7 @@ int usb_seremu_write(const void *buffer, uint32_t size)
 					tx_packet = usb_malloc();
 					if (tx_packet) break;
 				}
-				if (++wait_count > TX_TIMEOUT || transmit_previous_timeout) {
+				if (millis() - wait_begin_at > TX_TIMEOUT_MSEC || transmit_previous_timeout) {
 					transmit_previous_timeout = 1;
 					tx_noautoflush = 0;
 					return -1;
@@ -140,21 +140,17 @@ void usb_serial_flush_input(void)
 }
 
 // Maximum number of transmit packets to queue so we don't starve other endpoints for memory
+#ifdef CDC_TX_PACKET_LIMIT
+#define TX_PACKET_LIMIT CDC_TX_PACKET_LIMIT
+#else
 #define TX_PACKET_LIMIT 8
+#endif
 
 // When the PC isn't listening, how long do we wait before discarding data?  If this is
 // too short, we risk losing data during the stalls that are common with ordinary desktop
 // software.  If it's too long, we stall the user's program when no software is running.
 #define TX_TIMEOUT_MSEC 70
 
-#if F_CPU == 96000000
-  #define TX_TIMEOUT (TX_TIMEOUT_MSEC * 596)
-#elif F_CPU == 48000000
-  #define TX_TIMEOUT (TX_TIMEOUT_MSEC * 428)
-#elif F_CPU == 24000000
-  #define TX_TIMEOUT (TX_TIMEOUT_MSEC * 262)
-#endif
-
 // When we've suffered the transmit timeout, don't wait again until the computer
 // begins accepting data.  If no software is running to receive, we'll just discard
 // data as rapidly as Serial.print() can generate it, until there's something to
@@ -172,14 +168,14 @@ int usb_serial_putchar(uint8_t c)
 int usb_serial_write(const void *buffer, uint32_t size)
 {
 	uint32_t len;
-	uint32_t wait_count;
+	uint32_t wait_begin_at;
 	const uint8_t *src = (const uint8_t *)buffer;
 	uint8_t *dest;
 
 	tx_noautoflush = 1;
 	while (size > 0) {
 		if (!tx_packet) {
-			wait_count = 0;
+			wait_begin_at = millis();
 			while (1) {
 				if (!usb_configuration) {
 					tx_noautoflush = 0;
@@ -191,7 +187,7 @@ int usb_serial_write(const void *buffer, uint32_t size)
 					if (tx_packet) break;
 					tx_noautoflush = 0;
 				}
-				if (++wait_count > TX_TIMEOUT || transmit_previous_timeout) {
+				if (millis() - wait_begin_at > TX_TIMEOUT_MSEC || transmit_previous_timeout) {
 					transmit_previous_timeout = 1;
 					return -1;
 				}
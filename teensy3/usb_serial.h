@@ -31,7 +31,7 @@
 #ifndef USBserial_h_
 #define USBserial_h_
 
-#if defined(USB_SERIAL) || defined(USB_SERIAL_HID)
+#if defined(USB_SERIAL) || defined(USB_SERIAL_HID) || defined(USB_SERIAL_KEYBOARD_MOUSE)
 
 #include <inttypes.h>
 
@@ -103,5 +103,5 @@ extern usb_serial_class Serial;
 
 #endif // __cplusplus
 
-#endif // USB_SERIAL || USB_SERIAL_HID
+#endif // USB_SERIAL || USB_SERIAL_HID || USB_SERIAL_KEYBOARD_MOUSE
 #endif // USBserial_h_
@@ -0,0 +1,689 @@
+/// Copyright 2014 Henry G. Weller
+// -----------------------------------------------------------------------------
+//  This file is part of
+/// ---     TrackHand: DataHand with Laser TrackBall
+// -----------------------------------------------------------------------------
+//
+//  TrackHand is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  TrackHand is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+//  for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with TrackHand.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+
+#include "ADNS9800Model.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+// -----------------------------------------------------------------------------
+
+// Register addresses used by the model
+static const uint8_t Motion = 0x02;
+static const uint8_t Delta_X_L = 0x03;
+static const uint8_t Frame_Period_Lower = 0x0d;
+static const uint8_t Configuration_II = 0x10;
+static const uint8_t Frame_Capture = 0x12;
+static const uint8_t SROM_Enable = 0x13;
+static const uint8_t Run_Downshift = 0x14;
+static const uint8_t Rest1_Rate = 0x15;
+static const uint8_t Rest1_Downshift = 0x16;
+static const uint8_t Rest2_Rate = 0x17;
+static const uint8_t Rest2_Downshift = 0x18;
+static const uint8_t Rest3_Rate = 0x19;
+static const uint8_t Frame_Period_Max_Bound_Lower = 0x1a;
+static const uint8_t Frame_Period_Min_Bound_Lower = 0x1c;
+static const uint8_t LASER_CTRL0 = 0x20;
+static const uint8_t Observation = 0x24;
+static const uint8_t Data_Out_Lower = 0x25;
+static const uint8_t Data_Out_Upper = 0x26;
+static const uint8_t SROM_ID = 0x2a;
+static const uint8_t Power_Up_Reset = 0x3a;
+static const uint8_t Shutdown = 0x3b;
+static const uint8_t Motion_Burst = 0x50;
+static const uint8_t SROM_Load_Burst = 0x62;
+static const uint8_t Pixel_Burst = 0x64;
+
+// Length and CRC-16 (CCITT, initial value 0xffff) of the A6 SROM image
+static const uint16_t sromLength = 3070;
+static const uint16_t sromImageCrc = 0xae3d;
+
+// Timing requirements [ns]
+static const uint64_t us = 1000;
+static const uint64_t ms = 1000000;
+
+const char* ADNS9800Model::violationNames_[ADNS9800Model::nViolations] =
+{
+    "tNCS-SCLK",
+    "tSCLK-NCS",
+    "tSRAD",
+    "tSRAD-MOTBR",
+    "tSWW",
+    "tSWR",
+    "tSRW",
+    "tSRR",
+    "tBEXIT",
+    "tLOAD",
+    "tWAKEUP",
+    "tSROM-EN"
+};
+
+
+// Clip a 32bit integer to a 16bit integer
+static inline int16_t clip16(int32_t y)
+{
+    if (y > INT16_MAX) return INT16_MAX;
+    if (y < INT16_MIN) return INT16_MIN;
+    return y;
+}
+
+
+void ADNS9800Model::violated
+(
+    const violation v,
+    const uint64_t t,
+    const uint64_t elapsed,
+    const uint64_t required
+)
+{
+    violations_[v]++;
+
+    if (verbose_)
+    {
+        printf
+        (
+            "adnssim: %10.3fms %-11s %8.3fus of %8.3fus\n",
+            double(t)/ms,
+            violationNames_[v],
+            double(elapsed)/us,
+            double(required)/us
+        );
+    }
+}
+
+
+void ADNS9800Model::reset(const uint64_t t)
+{
+    memset(regs_, 0, sizeof(regs_));
+    regs_[0x00] = 0x33;
+    regs_[0x01] = 0x03;
+    regs_[0x0f] = 0x09;
+    regs_[Run_Downshift] = 0x32;
+    regs_[Rest1_Rate] = 0x00;
+    regs_[Rest1_Downshift] = 0x1f;
+    regs_[Rest2_Rate] = 0x09;
+    regs_[Rest2_Downshift] = 0xbc;
+    regs_[Rest3_Rate] = 0x31;
+    regs_[0x1a] = 0xc0;
+    regs_[0x1b] = 0x5d;
+    regs_[0x1c] = 0xa0;
+    regs_[0x1d] = 0x0f;
+    regs_[0x1e] = 0x20;
+    regs_[0x1f] = 0x4e;
+    regs_[LASER_CTRL0] = 0x01;
+    regs_[0x2e] = 0x10;
+    regs_[0x2f] = 0x12;
+    regs_[0x3f] = 0xcc;
+
+    resetTime_ = t;
+    shutdown_ = false;
+    mode_ = run;
+    lastMotion_ = t;
+
+    // Frames start when the sensor has booted
+    nextFrame_ = t + 50*ms;
+
+    // Motion during the reset is lost
+    bool lift;
+    position(t, px_, py_, lift);
+    dx_ = 0;
+    dy_ = 0;
+    lifted_ = lift;
+    motionPending_ = false;
+
+    sromEnabled_ = false;
+    sromCount_ = 0;
+    sromId_ = 0;
+    sromValid_ = false;
+    crcTestTime_ = 0;
+
+    frameCaptureArm_ = 0;
+    captured_ = false;
+}
+
+
+uint32_t ADNS9800Model::runPeriod() const
+{
+    const uint32_t maxBound =
+        regs_[Frame_Period_Max_Bound_Lower]
+      | (regs_[Frame_Period_Max_Bound_Lower + 1] << 8);
+
+    const uint32_t minBound =
+        regs_[Frame_Period_Min_Bound_Lower]
+      | (regs_[Frame_Period_Min_Bound_Lower + 1] << 8);
+
+    // With the automatic frame rate the surface is assumed bright enough
+    // to run at the minimum bound
+    if (regs_[Configuration_II] & 0x08 || minBound > maxBound)
+    {
+        return maxBound;
+    }
+    else
+    {
+        return minBound;
+    }
+}
+
+
+uint64_t ADNS9800Model::framePeriod() const
+{
+    switch (mode_)
+    {
+        case rest1:
+            return (regs_[Rest1_Rate] + 1)*ms;
+        case rest2:
+            return (regs_[Rest2_Rate] + 1)*ms;
+        case rest3:
+            return (regs_[Rest3_Rate] + 1)*ms;
+        default:
+            return uint64_t(runPeriod())*clock_;
+    }
+}
+
+
+void ADNS9800Model::position
+(
+    const uint64_t t,
+    double& x,
+    double& y,
+    bool& lift
+) const
+{
+    x = 0;
+    y = 0;
+    lift = false;
+
+    uint64_t start = scriptStart_;
+
+    for (size_t i=0; i<script_.size() && start < t; i++)
+    {
+        const segment& s = script_[i];
+        const uint64_t end = start + s.duration*ms;
+        const double dt = double((t < end ? t : end) - start)/1e9;
+
+        x += s.vx*dt;
+        y += s.vy*dt;
+        lift = t < end && s.lift;
+
+        start = end;
+    }
+}
+
+
+bool ADNS9800Model::navigating() const
+{
+    return
+        !shutdown_
+     && sromValid_
+     && !(regs_[LASER_CTRL0] & 0x01)
+     && !captured_;
+}
+
+
+uint8_t ADNS9800Model::latchMotion(const uint64_t t)
+{
+    const uint8_t motion =
+        regs_[Motion]
+      | (navigating() ? 0x20 : 0)
+      | (lifted_ ? 0x08 : 0)
+      | (mode_ << 1);
+
+    const int16_t dx = clip16(dx_);
+    const int16_t dy = clip16(dy_);
+
+    regs_[Delta_X_L] = dx & 0xff;
+    regs_[Delta_X_L + 1] = uint16_t(dx) >> 8;
+    regs_[Delta_X_L + 2] = dy & 0xff;
+    regs_[Delta_X_L + 3] = uint16_t(dy) >> 8;
+
+    dx_ = 0;
+    dy_ = 0;
+
+    // Reading the motion releases the MOT pin
+    regs_[Motion] &= ~0x80;
+
+    if (motionPending_)
+    {
+        const uint64_t latency = t - motionStart_;
+        latencySum_ += latency;
+        latencyCount_++;
+
+        if (latency > latencyMax_)
+        {
+            latencyMax_ = latency;
+        }
+
+        motionPending_ = false;
+    }
+
+    return motion;
+}
+
+
+uint8_t ADNS9800Model::readReg(const uint8_t addr, const uint64_t t)
+{
+    switch (addr)
+    {
+        case Motion:
+            return latchMotion(t);
+        case Data_Out_Lower:
+        case Data_Out_Upper:
+            // The CRC test result is available 10ms after it is started
+            if (crcTestTime_ && t - crcTestTime_ >= 10*ms && sromValid_)
+            {
+                return addr == Data_Out_Upper ? 0xbe : 0xef;
+            }
+            return 0;
+        case SROM_ID:
+            return sromId_;
+        default:
+            return regs_[addr];
+    }
+}
+
+
+void ADNS9800Model::writeReg
+(
+    const uint8_t addr,
+    const uint8_t data,
+    const uint64_t t
+)
+{
+    switch (addr)
+    {
+        case 0x00: case 0x01: case 0x03: case 0x04: case 0x05: case 0x06:
+        case 0x07: case 0x08: case 0x09: case 0x0a: case 0x0b: case 0x0c:
+        case 0x0d: case 0x0e: case SROM_ID: case 0x3f:
+            // Read-only
+            break;
+        case Motion:
+            // Clear the motion
+            dx_ = 0;
+            dy_ = 0;
+            regs_[Motion] &= ~0x80;
+            break;
+        case Observation:
+            regs_[Observation] = 0;
+            break;
+        case Power_Up_Reset:
+            if (data == 0x5a)
+            {
+                reset(t);
+            }
+            break;
+        case Shutdown:
+            if (data == 0xb6)
+            {
+                shutdown_ = true;
+                nextFrame_ = UINT64_MAX;
+            }
+            break;
+        case SROM_Enable:
+            if (data == 0x1d)
+            {
+                sromEnableTime_ = t;
+            }
+            else if (data == 0x18)
+            {
+                // At least one frame period after initialising the SROM
+                check(tSROM_EN, t, t - sromEnableTime_, framePeriod());
+                sromEnabled_ = true;
+                sromCount_ = 0;
+                sromCrc_ = 0xffff;
+            }
+            else if (data == 0x15)
+            {
+                crcTestTime_ = t;
+            }
+            break;
+        case Frame_Capture:
+            if (data == 0x93)
+            {
+                frameCaptureArm_ = 1;
+            }
+            else if (data == 0xc5 && frameCaptureArm_)
+            {
+                // Navigation halts until the next power-up reset
+                captured_ = true;
+                pixel_ = 0;
+                regs_[Motion] |= 0x01;
+            }
+            break;
+        default:
+            regs_[addr] = data;
+    }
+}
+
+
+void ADNS9800Model::sromByte(const uint8_t b)
+{
+    if (sromCount_ == 1)
+    {
+        sromByte1_ = b;
+    }
+
+    sromCount_++;
+    sromCrc_ ^= uint16_t(b) << 8;
+
+    for (uint8_t i=0; i<8; i++)
+    {
+        sromCrc_ = sromCrc_ & 0x8000 ? (sromCrc_ << 1) ^ 0x1021 : sromCrc_ << 1;
+    }
+}
+
+
+ADNS9800Model::ADNS9800Model()
+:
+    scriptStart_(UINT64_MAX),
+    verbose_(false),
+    bursts_(0),
+    latencySum_(0),
+    latencyMax_(0),
+    latencyCount_(0)
+{
+    memset(violations_, 0, sizeof(violations_));
+    generated_[0] = 0;
+    generated_[1] = 0;
+
+    selected_ = false;
+    selectTime_ = 0;
+    transaction_ = none;
+    lastTransaction_ = none;
+    lastByteEnd_ = 0;
+    lastEnd_ = 0;
+    sromEnableTime_ = 0;
+
+    reset(0);
+}
+
+
+uint32_t ADNS9800Model::scriptDuration() const
+{
+    uint32_t duration = 0;
+
+    for (size_t i=0; i<script_.size(); i++)
+    {
+        duration += script_[i].duration;
+    }
+
+    return duration;
+}
+
+
+void ADNS9800Model::select(const bool low, const uint64_t t)
+{
+    if (low == selected_)
+    {
+        return;
+    }
+
+    selected_ = low;
+
+    if (low)
+    {
+        selectTime_ = t;
+        transaction_ = none;
+        byteCount_ = 0;
+        return;
+    }
+
+    // NCS high ends the transaction
+    switch (transaction_)
+    {
+        case none:
+            return;
+        case write:
+            check(tSCLK_NCS, t, t - lastByteEnd_, 20*us);
+            lastEnd_ = lastByteEnd_;
+            break;
+        case read:
+            check(tSCLK_NCS, t, t - lastByteEnd_, 120);
+            lastEnd_ = lastByteEnd_;
+            break;
+        case sromBurst:
+            sromEnabled_ = false;
+            sromValid_ = sromCount_ == sromLength && sromCrc_ == sromImageCrc;
+            sromId_ = sromCount_ == sromLength ? sromByte1_ : 0;
+            lastEnd_ = t;
+            break;
+        case pixelBurst:
+            regs_[Motion] &= ~0x01;
+            lastEnd_ = t;
+            break;
+        default:
+            check(tSCLK_NCS, t, t - lastByteEnd_, 120);
+            lastEnd_ = t;
+    }
+
+    lastTransaction_ = transaction_;
+    transaction_ = none;
+}
+
+
+uint8_t ADNS9800Model::transfer
+(
+    const uint8_t mosi,
+    const uint64_t start,
+    const uint64_t end
+)
+{
+    if (!selected_)
+    {
+        return 0xff;
+    }
+
+    uint8_t miso = 0;
+
+    if (byteCount_ == 0)
+    {
+        const bool isWrite = mosi & 0x80;
+        address_ = mosi & 0x7f;
+
+        check(tNCS_SCLK, start, start - selectTime_, 120);
+
+        // The sensor must boot before it is accessed,
+        // other than to be reset again
+        if (!(isWrite && address_ == Power_Up_Reset))
+        {
+            check(tWAKEUP, start, start - resetTime_, 50*ms);
+        }
+
+        const uint64_t elapsed = start - lastEnd_;
+
+        switch (lastTransaction_)
+        {
+            case write:
+                check(isWrite ? tSWW : tSWR, start, elapsed, 120*us);
+                break;
+            case read:
+                check(isWrite ? tSRW : tSRR, start, elapsed, 20*us);
+                break;
+            case none:
+                break;
+            default:
+                check(tBEXIT, start, elapsed, 500);
+        }
+
+        if (isWrite)
+        {
+            transaction_ =
+                address_ == SROM_Load_Burst && sromEnabled_ ? sromBurst : write;
+        }
+        else if (address_ == Motion_Burst)
+        {
+            transaction_ = motionBurst;
+            bursts_++;
+        }
+        else if (address_ == Pixel_Burst)
+        {
+            transaction_ = pixelBurst;
+        }
+        else
+        {
+            transaction_ = read;
+        }
+    }
+    else
+    {
+        const uint64_t elapsed = start - lastByteEnd_;
+
+        switch (transaction_)
+        {
+            case read:
+                if (byteCount_ == 1)
+                {
+                    check(tSRAD, start, elapsed, 100*us);
+                    miso = readReg(address_, start);
+                }
+                break;
+            case write:
+                if (byteCount_ == 1)
+                {
+                    writeReg(address_, mosi, end);
+                }
+                break;
+            case motionBurst:
+                if (byteCount_ == 1)
+                {
+                    check(tSRAD_MOTBR, start, elapsed, 35*us);
+
+                    burst_[0] = latchMotion(start);
+                    burst_[1] = regs_[Observation];
+                    memcpy(burst_ + 2, regs_ + Delta_X_L, 4);
+                    burst_[6] = lifted_ ? 0 : 0x40;
+                    burst_[7] = 0x60;
+                    burst_[8] = 0xa0;
+                    burst_[9] = 0x20;
+                    burst_[10] = 0x01;
+                    burst_[11] = 0x00;
+                    burst_[12] = regs_[Frame_Period_Lower + 1];
+                    burst_[13] = regs_[Frame_Period_Lower];
+                }
+                if (byteCount_ <= sizeof(burst_))
+                {
+                    miso = burst_[byteCount_ - 1];
+                }
+                break;
+            case sromBurst:
+                // Including the wait after the address
+                check(tLOAD, start, elapsed, 15*us);
+                sromByte(mosi);
+                break;
+            case pixelBurst:
+                if (byteCount_ == 1)
+                {
+                    check(tSRAD, start, elapsed, 100*us);
+                }
+                {
+                    // Diagonal gradient, 30x30 pixels of 7 bits
+                    const uint8_t x = pixel_/30;
+                    const uint8_t y = pixel_%30;
+                    miso = (2*(x + y)) & 0x7f;
+                    pixel_ = (pixel_ + 1)%900;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    byteCount_++;
+    lastByteEnd_ = end;
+
+    return miso;
+}
+
+
+void ADNS9800Model::frame(const uint64_t t)
+{
+    double x, y;
+    bool lift;
+    position(t, x, y, lift);
+
+    regs_[Observation] |= 0x3f;
+
+    if (navigating())
+    {
+        lifted_ = lift;
+
+        if (!lift)
+        {
+            const int32_t dx = int32_t(floor(x) - floor(px_));
+            const int32_t dy = int32_t(floor(y) - floor(py_));
+
+            if (dx || dy)
+            {
+                dx_ += dx;
+                dy_ += dy;
+                generated_[0] += dx;
+                generated_[1] += dy;
+
+                if (!motionPending_)
+                {
+                    motionPending_ = true;
+                    motionStart_ = t;
+                }
+
+                regs_[Motion] |= 0x80;
+                lastMotion_ = t;
+            }
+        }
+    }
+
+    px_ = x;
+    py_ = y;
+
+    // Downshift through the rest modes while there is no motion
+    mode_ = run;
+
+    if (regs_[Configuration_II] & 0x20 && navigating())
+    {
+        const uint64_t still = t - lastMotion_;
+        const uint64_t run1 = regs_[Run_Downshift]*10*ms;
+        const uint64_t rest12 =
+            run1 + regs_[Rest1_Downshift]*32*(regs_[Rest1_Rate] + 1)*ms;
+        const uint64_t rest23 =
+            rest12 + regs_[Rest2_Downshift]*32*(regs_[Rest2_Rate] + 1)*ms;
+
+        if (still >= rest23)
+        {
+            mode_ = rest3;
+        }
+        else if (still >= rest12)
+        {
+            mode_ = rest2;
+        }
+        else if (still >= run1)
+        {
+            mode_ = rest1;
+        }
+    }
+
+    const uint64_t period = framePeriod();
+    const uint32_t clocks = period/clock_ > 0xffff ? 0xffff : period/clock_;
+    regs_[Frame_Period_Lower] = clocks & 0xff;
+    regs_[Frame_Period_Lower + 1] = clocks >> 8;
+
+    nextFrame_ = t + period;
+}
+
+
+// -----------------------------------------------------------------------------
@@ -0,0 +1,324 @@
+/// Copyright 2014 Henry G. Weller
+// -----------------------------------------------------------------------------
+//  This file is part of
+/// ---     TrackHand: DataHand with Laser TrackBall
+// -----------------------------------------------------------------------------
+//
+//  TrackHand is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  TrackHand is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+//  for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with TrackHand.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+/// Title: Register-level behavioural model of the ADNS-9800
+///  Description:
+//    Models the SPI port of the sensor byte by byte on the simulated clock:
+//    power-up reset and shutdown, SROM upload with the SROM_ID and CRC test,
+//    the register file, motion burst and frame capture.  Each frame
+//    integrates the ball motion from a script of constant-velocity segments,
+//    optionally lifted, into the delta registers and drives the MOT pin.
+//    The run and rest modes follow Configuration_II and the downshift
+//    registers.
+//
+//    Every access is checked against the datasheet timing and each
+//    violation counted and optionally logged.
+//
+//    The frame rate and downshift times are approximations sufficient to
+//    exercise the driver, not a characterisation of the sensor.
+// -----------------------------------------------------------------------------
+
+#ifndef ADNS9800Model_H
+#define ADNS9800Model_H
+
+#include <stdint.h>
+#include <vector>
+
+// -----------------------------------------------------------------------------
+
+class ADNS9800Model
+{
+public:
+
+    //- Timing requirements checked
+    enum violation
+    {
+        tNCS_SCLK,      // NCS low to first SCLK, 120ns
+        tSCLK_NCS,      // Last SCLK to NCS high, 120ns read, 20us write
+        tSRAD,          // Read address to data, 100us
+        tSRAD_MOTBR,    // Motion burst address to data, 35us
+        tSWW,           // Write to next write, 120us
+        tSWR,           // Write to next read, 120us
+        tSRW,           // Read to next write, 20us
+        tSRR,           // Read to next read, 20us
+        tBEXIT,         // Burst exit to next access, 500ns
+        tLOAD,          // Between SROM download bytes, 15us
+        tWAKEUP,        // Power-up reset to first access, 50ms
+        tSROM_EN,       // SROM_Enable to download, one frame
+        nViolations
+    };
+
+    //- Names of the timing requirements
+    static const char* violationNames_[nViolations];
+
+    //- Ball motion at constant velocity [counts/s] for a duration [ms]
+    struct segment
+    {
+        double vx;
+        double vy;
+        uint32_t duration;
+        bool lift;
+    };
+
+
+private:
+
+    //- Operating mode
+    enum mode
+    {
+        run,
+        rest1,
+        rest2,
+        rest3
+    };
+
+    //- Type of the transaction in progress or last completed
+    enum transaction
+    {
+        none,
+        read,
+        write,
+        motionBurst,
+        sromBurst,
+        pixelBurst
+    };
+
+    // Clock period of the sensor frame timing [ns], 50MHz
+    static const uint32_t clock_ = 20;
+
+    //- Register file
+    uint8_t regs_[0x40];
+
+    //- Time of the power-up reset [ns]
+    uint64_t resetTime_;
+
+    //- Set while shut down
+    bool shutdown_;
+
+    //- Current operating mode and time of the last motion
+    mode mode_;
+    uint64_t lastMotion_;
+
+    //- Time of the next frame [ns]
+    uint64_t nextFrame_;
+
+    //- Script of the ball motion, the time it started [ns]
+    //  and the position at the last frame
+    std::vector<segment> script_;
+    uint64_t scriptStart_;
+    double px_, py_;
+
+    //- Motion accumulated since the last latch
+    int32_t dx_, dy_;
+    bool lifted_;
+
+    //- Time of the first frame with motion not yet read [ns]
+    bool motionPending_;
+    uint64_t motionStart_;
+
+    //- Motion burst data latched at the first byte
+    uint8_t burst_[14];
+
+    //- SROM download state
+    uint64_t sromEnableTime_;
+    bool sromEnabled_;
+    uint16_t sromCount_;
+    uint16_t sromCrc_;
+    uint8_t sromByte1_;
+    uint8_t sromId_;
+    bool sromValid_;
+    uint64_t crcTestTime_;
+
+    //- Frame capture state
+    uint8_t frameCaptureArm_;
+    bool captured_;
+    uint16_t pixel_;
+
+    //- SPI port state
+    bool selected_;
+    uint64_t selectTime_;
+    transaction transaction_;
+    uint8_t address_;
+    uint16_t byteCount_;
+    uint64_t lastByteEnd_;
+    transaction lastTransaction_;
+    uint64_t lastEnd_;
+
+    //- Number of each timing violation
+    uint32_t violations_[nViolations];
+
+    //- Print each violation as it occurs
+    bool verbose_;
+
+    //- Motion counts generated and the number of bursts read
+    int64_t generated_[2];
+    uint32_t bursts_;
+
+    //- Motion-to-read latency statistics [ns]
+    uint64_t latencySum_;
+    uint64_t latencyMax_;
+    uint32_t latencyCount_;
+
+
+    // Private member functions
+
+        //- Record a violation of the requirement
+        //  for which only elapsed of required [ns] passed
+        void violated
+        (
+            const violation v,
+            const uint64_t t,
+            const uint64_t elapsed,
+            const uint64_t required
+        );
+
+        //- Check that at least required [ns] have elapsed
+        void check
+        (
+            const violation v,
+            const uint64_t t,
+            const uint64_t elapsed,
+            const uint64_t required
+        )
+        {
+            if (elapsed < required)
+            {
+                violated(v, t, elapsed, required);
+            }
+        }
+
+        //- Restore the register defaults
+        void reset(const uint64_t t);
+
+        //- Return the frame period in run mode [clocks]
+        uint32_t runPeriod() const;
+
+        //- Return the current frame period [ns]
+        uint64_t framePeriod() const;
+
+        //- Return the ball position at time t [counts]
+        void position(const uint64_t t, double& x, double& y, bool& lift) const;
+
+        //- Return the value of the register for a read
+        uint8_t readReg(const uint8_t addr, const uint64_t t);
+
+        //- Write the register
+        void writeReg(const uint8_t addr, const uint8_t data, const uint64_t t);
+
+        //- Latch the accumulated motion into the delta registers
+        //  returning the Motion register
+        uint8_t latchMotion(const uint64_t t);
+
+        //- Return true if the sensor is navigating
+        bool navigating() const;
+
+        //- Update the SROM CRC with the byte
+        void sromByte(const uint8_t b);
+
+
+public:
+
+    // Constructor
+    ADNS9800Model();
+
+    // Member functions
+
+        //- Print each violation as it occurs
+        void verbose(const bool v)
+        {
+            verbose_ = v;
+        }
+
+        //- Append a segment to the motion script
+        void addSegment(const segment& s)
+        {
+            script_.push_back(s);
+        }
+
+        //- Return the total duration of the motion script [ms]
+        uint32_t scriptDuration() const;
+
+        //- Start the motion script at time t
+        void startScript(const uint64_t t)
+        {
+            scriptStart_ = t;
+        }
+
+        //- NCS pin changed at time t
+        void select(const bool low, const uint64_t t);
+
+        //- Exchange a byte clocked from time start to end [ns]
+        uint8_t transfer(const uint8_t mosi, const uint64_t start, const uint64_t end);
+
+        //- Return the time of the next frame [ns]
+        uint64_t nextFrame() const
+        {
+            return nextFrame_;
+        }
+
+        //- Capture the frame at time t integrating the motion
+        void frame(const uint64_t t);
+
+        //- Return the level of the MOT pin, low while motion is reported
+        bool mot() const
+        {
+            return !(regs_[0x02] & 0x80);
+        }
+
+        //- Return the number of each violation
+        uint32_t violations(const violation v) const
+        {
+            return violations_[v];
+        }
+
+        //- Return the motion counts generated while not lifted
+        int64_t generated(const uint8_t i) const
+        {
+            return generated_[i];
+        }
+
+        //- Return the number of motion bursts read
+        uint32_t bursts() const
+        {
+            return bursts_;
+        }
+
+        //- Return true if the SROM has been loaded and verified
+        bool sromValid() const
+        {
+            return sromValid_;
+        }
+
+        //- Return the mean and maximum motion-to-read latency [ns]
+        uint64_t latencyMean() const
+        {
+            return latencyCount_ ? latencySum_/latencyCount_ : 0;
+        }
+
+        uint64_t latencyMax() const
+        {
+            return latencyMax_;
+        }
+};
+
+
+// -----------------------------------------------------------------------------
+#endif // ADNS9800Model_H
+// -----------------------------------------------------------------------------
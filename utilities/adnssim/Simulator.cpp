@@ -0,0 +1,527 @@
+/// Copyright 2014 Henry G. Weller
+// -----------------------------------------------------------------------------
+//  This file is part of
+/// ---     TrackHand: DataHand with Laser TrackBall
+// -----------------------------------------------------------------------------
+//
+//  TrackHand is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  TrackHand is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+//  for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with TrackHand.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+
+#include "Simulator.h"
+#include "WProgram.h"
+#include "spi4teensy3.h"
+
+// -----------------------------------------------------------------------------
+
+// Nominal CPU time charged for each call to the core functions,
+// about 10 cycles at 48MHz [ns]
+static const uint64_t callTime = 200;
+
+// Interrupt entry latency, 12 cycles at 48MHz [ns]
+static const uint64_t interruptLatency = 250;
+
+// Bus clock dividing the SPI clock [Hz]
+static const uint32_t busClock = 48000000;
+
+// Bus clock divisor of each SPI speed value, as spi4teensy3
+static const uint8_t sclkDivisors[] = {2, 4, 8, 12, 16, 48, 96, 192};
+
+// Depth of the SPI transmit FIFO filled by paced DMA transfers [bytes]
+static const uint8_t txFifoDepth = 4;
+
+static const uint8_t maxSensors = 2;
+
+static const uint8_t nPins = 64;
+
+static uint64_t now_ = 0;
+
+// Time to clock a byte at the SPI clock set by init [ns]
+static uint64_t byteTime_ = 8ULL*1000000000/(busClock/sclkDivisors[0]);
+
+static uint64_t busBusy_ = 0;
+
+static uint32_t conflicts_ = 0;
+
+// Connected sensors
+static struct
+{
+    ADNS9800Model* model;
+    uint8_t ncs;
+    uint8_t mot;
+    bool selected;
+    bool motLevel;
+} sensors_[maxSensors];
+
+static uint8_t nSensors_ = 0;
+
+// Interrupt functions attached to the pins and those pending
+static void (*pinISRs_[nPins])() = {NULL};
+static bool pinPending_[nPins] = {false};
+
+static bool irqDisabled_ = false;
+static bool inISR_ = false;
+
+// DMA transfer in progress
+static struct
+{
+    bool active;
+    const uint8_t* tx;
+    uint8_t* rx;
+    size_t n;
+    size_t i;
+    uint64_t interval;
+    uint64_t start;
+    uint64_t next;
+    void (*callback)();
+    bool pending;
+} dma_ = {false, NULL, NULL, 0, 0, 0, 0, 0, NULL, false};
+
+
+// Return the selected sensor counting a conflict if more than one is
+static ADNS9800Model* selected()
+{
+    ADNS9800Model* model = NULL;
+
+    for (uint8_t i=0; i<nSensors_; i++)
+    {
+        if (sensors_[i].selected)
+        {
+            if (model)
+            {
+                conflicts_++;
+            }
+
+            model = sensors_[i].model;
+        }
+    }
+
+    return model;
+}
+
+
+// Clock a byte starting now to the selected sensor and return the reply
+static uint8_t clockByte(const uint8_t mosi)
+{
+    ADNS9800Model* model = selected();
+    busBusy_ += byteTime_;
+
+    return model ? model->transfer(mosi, now_, now_ + byteTime_) : 0xff;
+}
+
+
+// Set the interrupt pending on the falling edge of any MOT pin
+static void updatePins()
+{
+    for (uint8_t i=0; i<nSensors_; i++)
+    {
+        const bool level = sensors_[i].model->mot();
+
+        if (sensors_[i].motLevel && !level && pinISRs_[sensors_[i].mot])
+        {
+            pinPending_[sensors_[i].mot] = true;
+        }
+
+        sensors_[i].motLevel = level;
+    }
+}
+
+
+// Return true if any interrupt is pending
+static bool interruptPending()
+{
+    for (uint8_t pin=0; pin<nPins; pin++)
+    {
+        if (pinPending_[pin])
+        {
+            return true;
+        }
+    }
+
+    return dma_.pending;
+}
+
+
+// Call the pending interrupt functions unless disabled or already in one
+static void serviceInterrupts()
+{
+    if (irqDisabled_ || inISR_ || !interruptPending())
+    {
+        return;
+    }
+
+    inISR_ = true;
+    now_ += interruptLatency;
+
+    if (dma_.pending)
+    {
+        dma_.active = false;
+        dma_.pending = false;
+
+        if (dma_.callback)
+        {
+            dma_.callback();
+        }
+    }
+
+    for (uint8_t pin=0; pin<nPins; pin++)
+    {
+        if (pinPending_[pin])
+        {
+            pinPending_[pin] = false;
+            pinISRs_[pin]();
+        }
+    }
+
+    inISR_ = false;
+}
+
+
+// Clock the next byte of the DMA transfer or complete it
+static void dmaStep()
+{
+    if (dma_.i == dma_.n)
+    {
+        // The last byte has been clocked, the transfer remains active until
+        // the completion interrupt is serviced
+        dma_.pending = true;
+        return;
+    }
+
+    // A paced byte pushed while the transmit FIFO is full is lost and the
+    // transfer never completes on the device, count it as a conflict
+    if
+    (
+        dma_.interval
+     && now_ >= dma_.start + (dma_.i + txFifoDepth)*dma_.interval
+    )
+    {
+        conflicts_++;
+    }
+
+    const uint8_t miso = clockByte(dma_.tx ? dma_.tx[dma_.i] : 0xff);
+
+    if (dma_.rx)
+    {
+        dma_.rx[dma_.i] = miso;
+    }
+
+    dma_.i++;
+
+    // Paced bytes are pushed at fixed times but cannot start before the
+    // previous has been clocked
+    const uint64_t end = now_ + byteTime_;
+    const uint64_t push = dma_.start + dma_.i*dma_.interval;
+    dma_.next = dma_.interval && push > end ? push : end;
+
+    if (dma_.i == dma_.n)
+    {
+        dma_.next = end;
+    }
+}
+
+
+static void dmaStart
+(
+    const void* txbuf,
+    void* rxbuf,
+    size_t n,
+    void (*callback)(),
+    uint16_t interval,
+    uint16_t delay
+)
+{
+    if (dma_.active)
+    {
+        conflicts_++;
+    }
+
+    dma_.active = true;
+    dma_.tx = static_cast<const uint8_t*>(txbuf);
+    dma_.rx = static_cast<uint8_t*>(rxbuf);
+    dma_.n = n;
+    dma_.i = 0;
+    dma_.interval = interval*1000ULL;
+    dma_.start = now_ + (interval ? (delay ? delay : interval)*1000ULL : 0);
+    dma_.next = dma_.start;
+    dma_.callback = callback;
+    dma_.pending = false;
+}
+
+
+uint64_t Simulator::now()
+{
+    return now_;
+}
+
+
+void Simulator::addSensor
+(
+    ADNS9800Model& sensor,
+    const uint8_t ncs,
+    const uint8_t mot
+)
+{
+    if (nSensors_ < maxSensors)
+    {
+        sensors_[nSensors_].model = &sensor;
+        sensors_[nSensors_].ncs = ncs;
+        sensors_[nSensors_].mot = mot;
+        sensors_[nSensors_].selected = false;
+        sensors_[nSensors_].motLevel = true;
+        nSensors_++;
+    }
+}
+
+
+void Simulator::advance(const uint64_t dt)
+{
+    const uint64_t target = now_ + dt;
+
+    while (true)
+    {
+        // Find the next frame or DMA byte
+        uint64_t next = target;
+        int8_t sensor = -1;
+
+        for (uint8_t i=0; i<nSensors_; i++)
+        {
+            if (sensors_[i].model->nextFrame() <= next)
+            {
+                next = sensors_[i].model->nextFrame();
+                sensor = i;
+            }
+        }
+
+        const bool dmaNext =
+            dma_.active && !dma_.pending && dma_.next <= next;
+
+        if (dmaNext)
+        {
+            next = dma_.next;
+        }
+        else if (sensor < 0)
+        {
+            break;
+        }
+
+        if (next > now_)
+        {
+            now_ = next;
+        }
+
+        if (dmaNext)
+        {
+            dmaStep();
+        }
+        else
+        {
+            sensors_[sensor].model->frame(now_);
+        }
+
+        updatePins();
+
+        // Interrupt functions run when the event occurs and may themselves
+        // advance the time
+        serviceInterrupts();
+    }
+
+    if (target > now_)
+    {
+        now_ = target;
+    }
+}
+
+
+uint64_t Simulator::busBusy()
+{
+    return busBusy_;
+}
+
+
+uint32_t Simulator::conflicts()
+{
+    return conflicts_;
+}
+
+
+// -----------------------------------------------------------------------------
+// WProgram.h
+
+uint32_t micros()
+{
+    Simulator::advance(callTime);
+    return now_/1000;
+}
+
+
+uint32_t millis()
+{
+    Simulator::advance(callTime);
+    return now_/1000000;
+}
+
+
+void delayMicroseconds(uint32_t usec)
+{
+    Simulator::advance(usec*1000ULL);
+}
+
+
+void pinMode(uint8_t pin, uint8_t mode)
+{}
+
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+    Simulator::advance(callTime);
+
+    for (uint8_t i=0; i<nSensors_; i++)
+    {
+        if (sensors_[i].ncs == pin)
+        {
+            sensors_[i].selected = val == LOW;
+            sensors_[i].model->select(val == LOW, now_);
+        }
+    }
+
+    updatePins();
+}
+
+
+void attachInterrupt(uint8_t pin, void (*function)(), int mode)
+{
+    if (pin < nPins)
+    {
+        pinISRs_[pin] = function;
+    }
+}
+
+
+void __disable_irq()
+{
+    irqDisabled_ = true;
+}
+
+
+void __enable_irq()
+{
+    irqDisabled_ = false;
+    serviceInterrupts();
+}
+
+
+// -----------------------------------------------------------------------------
+// spi4teensy3.h
+
+namespace spi4teensy3
+{
+        void init()
+        {
+                init(0);
+        }
+
+        void init(uint8_t speed)
+        {
+                byteTime_ = 8ULL*1000000000/sclk(speed);
+        }
+
+        void init(uint8_t cpol, uint8_t cpha)
+        {
+                init();
+        }
+
+        void init(uint8_t speed, uint8_t cpol, uint8_t cpha)
+        {
+                init(speed);
+        }
+
+        uint8_t speed(uint32_t hz)
+        {
+                uint8_t s;
+                for(s = 0; s < 7; s++) {
+                        if(sclk(s) <= hz) {
+                                break;
+                        }
+                }
+                return s;
+        }
+
+        uint32_t sclk(uint8_t speed)
+        {
+                return busClock/sclkDivisors[speed < sizeof(sclkDivisors) ? speed : 0];
+        }
+
+        void send(uint8_t b)
+        {
+                if(dma_.active) {
+                        conflicts_++;
+                }
+                Simulator::advance(callTime);
+                clockByte(b);
+                Simulator::advance(byteTime_);
+                updatePins();
+        }
+
+        void send(void *bufr, size_t n)
+        {
+                for(size_t i = 0; i < n; i++) {
+                        send(static_cast<uint8_t*>(bufr)[i]);
+                }
+        }
+
+        uint8_t receive()
+        {
+                if(dma_.active) {
+                        conflicts_++;
+                }
+                Simulator::advance(callTime);
+                const uint8_t b = clockByte(0xff);
+                Simulator::advance(byteTime_);
+                updatePins();
+                return b;
+        }
+
+        void receive(void *bufr, size_t n)
+        {
+                for(size_t i = 0; i < n; i++) {
+                        static_cast<uint8_t*>(bufr)[i] = receive();
+                }
+        }
+
+        void dmaSend(const void *bufr, size_t n, void (*callback)(), uint16_t interval)
+        {
+                dmaStart(bufr, NULL, n, callback, interval, 0);
+        }
+
+        void dmaReceive(void *bufr, size_t n, void (*callback)(), uint16_t interval, uint16_t delay)
+        {
+                dmaStart(NULL, bufr, n, callback, interval, delay);
+        }
+
+        bool dmaBusy()
+        {
+                return dma_.active;
+        }
+
+        void dmaWait()
+        {
+                while(dma_.active) {
+                        Simulator::advance(byteTime_);
+                }
+        }
+};
+
+
+// -----------------------------------------------------------------------------
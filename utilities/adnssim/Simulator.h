@@ -0,0 +1,60 @@
+/// Copyright 2014 Henry G. Weller
+// -----------------------------------------------------------------------------
+//  This file is part of
+/// ---     TrackHand: DataHand with Laser TrackBall
+// -----------------------------------------------------------------------------
+//
+//  TrackHand is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  TrackHand is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+//  for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with TrackHand.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+/// Title: Simulated clock, pins, interrupts and SPI bus
+///  Description:
+//    Implements the host WProgram.h and spi4teensy3.h on a nanosecond clock
+//    which advances only as the driver calls the core functions, each of
+//    which is charged a nominal CPU time.  While the clock advances the
+//    sensor frames and DMA transfers proceed, the MOT pins are monitored
+//    and the interrupt functions called unless disabled.
+// -----------------------------------------------------------------------------
+
+#ifndef Simulator_H
+#define Simulator_H
+
+#include "ADNS9800Model.h"
+
+// -----------------------------------------------------------------------------
+
+namespace Simulator
+{
+    //- Return the simulated time [ns]
+    uint64_t now();
+
+    //- Connect a sensor with the select and motion interrupt pins
+    void addSensor(ADNS9800Model& sensor, const uint8_t ncs, const uint8_t mot);
+
+    //- Advance the simulated time by dt [ns]
+    void advance(const uint64_t dt);
+
+    //- Return the time the SPI bus has been clocking [ns]
+    uint64_t busBusy();
+
+    //- Return the number of SPI bus conflicts, i.e. bytes clocked with
+    //  more than one device selected or while a DMA transfer is in progress
+    //  and paced DMA bytes pushed into a full transmit FIFO
+    uint32_t conflicts();
+}
+
+
+// -----------------------------------------------------------------------------
+#endif // Simulator_H
+// -----------------------------------------------------------------------------
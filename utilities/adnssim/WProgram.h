@@ -0,0 +1,67 @@
+/// Copyright 2014 Henry G. Weller
+// -----------------------------------------------------------------------------
+//  This file is part of
+/// ---     TrackHand: DataHand with Laser TrackBall
+// -----------------------------------------------------------------------------
+//
+//  TrackHand is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  TrackHand is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+//  for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with TrackHand.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+/// Title: Host replacement for the Teensy core used by the ADNS9800 driver
+///  Description:
+//    Provides the subset of the Arduino/Teensyduino interface used by
+//    libraries/ADNS9800 implemented on the simulated clock, pins and
+//    interrupts of the Simulator so that the unmodified driver can be
+//    compiled and run on the host.
+// -----------------------------------------------------------------------------
+
+#ifndef WProgram_H
+#define WProgram_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+// -----------------------------------------------------------------------------
+
+#define HIGH 1
+#define LOW 0
+
+#define INPUT 0
+#define OUTPUT 1
+
+#define FALLING 2
+
+// Teensy 3 SPI pins
+#define SS 10
+#define MOSI 11
+#define MISO 12
+#define SCK 13
+
+uint32_t micros();
+uint32_t millis();
+void delayMicroseconds(uint32_t usec);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+void attachInterrupt(uint8_t pin, void (*function)(), int mode);
+
+void __disable_irq();
+void __enable_irq();
+
+
+// -----------------------------------------------------------------------------
+#endif // WProgram_H
+// -----------------------------------------------------------------------------
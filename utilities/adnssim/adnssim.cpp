@@ -0,0 +1,453 @@
+/// Copyright 2014 Henry G. Weller
+// -----------------------------------------------------------------------------
+//  This file is part of
+/// ---     TrackHand: DataHand with Laser TrackBall
+// -----------------------------------------------------------------------------
+//
+//  TrackHand is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  TrackHand is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+//  for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with TrackHand.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+/// Title: ADNS-9800 driver simulator
+///  Description:
+//    Runs the ADNS9800 driver from libraries/ADNS9800 against the
+//    register-level sensor model on a simulated clock in place of the
+//    hardware.  The driver is woken, optionally set to a sensor profile, and
+//    then the motion bursts read in a loop of the given period as the
+//    TrackBall does while the ball follows the motion script, which starts
+//    when the sensors are ready.  The motion of the first sensor is replayed
+//    through the TrackBall PointerMotion acceleration and scaling.
+//
+//    Reports the datasheet timing violations, SPI bus conflicts, the number
+//    of motion bursts, the motion lost, the motion-to-read latency and the
+//    pointer drift, i.e. the difference between the sum of the pointer
+//    motion sent and the sum of the scaled motion, and exits with status 1
+//    if there are any violations, conflicts, lost motion or drift.
+// -----------------------------------------------------------------------------
+
+#include "ADNS9800.h"
+#include "ADNS9800Model.h"
+#include "Simulator.h"
+#include "PointerMotion.h"
+
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <getopt.h>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+// -----------------------------------------------------------------------------
+
+// Pins of the scroll ball, see TrackHand/TrackBall.h
+static const uint8_t scrollBallNcs = 26;
+static const uint8_t scrollBallMot = 27;
+
+static ADNS9800Model sensorModels[2];
+
+
+// Parse "a,b,c" into the numbers, returning false on error
+bool parseNumbers(const char* arg, double* values, const int n)
+{
+    char* end;
+
+    for (int i=0; i<n; i++)
+    {
+        values[i] = std::strtod(arg, &end);
+
+        if (end == arg || (i < n - 1 && *end != ','))
+        {
+            return false;
+        }
+
+        arg = end + 1;
+    }
+
+    return *end == '\0';
+}
+
+
+void printUsage(std::ostream& os, int exitCode)
+{
+    os  << "Usage: adnssim [OPTION]...\n"
+        "Run the ADNS9800 driver against the simulated sensor.\n\n"
+        "  -h  --help                  Display this usage information.\n"
+        "  -m  --move <vx>,<vy>,<ms>   Move the ball at vx,vy counts/s for ms.\n"
+        "  -i  --still <ms>            Keep the ball still for ms.\n"
+        "  -l  --lift <ms>             Lift the ball off the sensor for ms.\n"
+        "  -t  --time <ms>             Time to run once the sensors are ready,\n"
+        "                              default the script duration + 1000ms.\n"
+        "  -f  --profile <n>           Select the sensor profile when ready.\n"
+        "  -p  --period <us>           Period of the driver loop, default 100.\n"
+        "  -2  --scrollball            Add a second sensor as the scroll ball.\n"
+        "  -x  --scale <sx>,<sy>       Scale of the pointer x and y motion,\n"
+        "                              default 1,1.\n"
+        "  -a  --accel <g0,...,g7>     Pointer acceleration curve gains in units\n"
+        "                              of 1/16, default 16 for all.\n"
+        "  -v  --verbose               Print each timing violation.\n"
+    ;
+
+    std::exit(exitCode);
+}
+
+
+int main(int argc, char * const *argv)
+{
+    // A string listing valid short options letters.
+    const char* const shortOptions = "hm:i:l:t:f:p:2x:a:v";
+
+    // An array describing valid long options.
+    const struct option longOptions[] =
+    {
+        { "help",         0, NULL, 'h' },
+        { "move",         1, NULL, 'm' },
+        { "still",        1, NULL, 'i' },
+        { "lift",         1, NULL, 'l' },
+        { "time",         1, NULL, 't' },
+        { "profile",      1, NULL, 'f' },
+        { "period",       1, NULL, 'p' },
+        { "scrollball",   0, NULL, '2' },
+        { "scale",        1, NULL, 'x' },
+        { "accel",        1, NULL, 'a' },
+        { "verbose",      0, NULL, 'v' },
+        { NULL,           0, NULL, 0   }   // Required at end of array.
+    };
+
+    uint32_t duration = 0;
+    int profile = -1;
+    uint32_t period = 100;
+    uint8_t nSensors = 1;
+    bool verbose = false;
+    PointerMotion pointer;
+
+    int opt;
+
+    do
+    {
+        opt = getopt_long
+        (
+            argc,
+            argv,
+            shortOptions,
+            longOptions,
+            NULL
+        );
+
+        switch (opt)
+        {
+            case 'h':
+                printUsage(cout, 0);
+                break;
+
+            case 'm':
+                {
+                    double v[3];
+                    if (!parseNumbers(optarg, v, 3) || v[2] < 0)
+                    {
+                        printUsage(cerr, 1);
+                    }
+                    const ADNS9800Model::segment s =
+                        {v[0], v[1], uint32_t(v[2]), false};
+                    sensorModels[0].addSegment(s);
+                    sensorModels[1].addSegment(s);
+                }
+                break;
+
+            case 'i':
+            case 'l':
+                {
+                    const ADNS9800Model::segment s =
+                        {0, 0, uint32_t(std::atoi(optarg)), opt == 'l'};
+                    sensorModels[0].addSegment(s);
+                    sensorModels[1].addSegment(s);
+                }
+                break;
+
+            case 't':
+                duration = std::atoi(optarg);
+                break;
+
+            case 'f':
+                profile = std::atoi(optarg);
+                if (profile < 0 || profile >= ADNS9800::nProfiles)
+                {
+                    printUsage(cerr, 1);
+                }
+                break;
+
+            case 'p':
+                period = std::atoi(optarg);
+                break;
+
+            case '2':
+                nSensors = 2;
+                break;
+
+            case 'x':
+                {
+                    double v[2];
+                    if (!parseNumbers(optarg, v, 2) || v[0] < 0 || v[1] < 0)
+                    {
+                        printUsage(cerr, 1);
+                    }
+                    for (uint8_t i=0; i<2; i++)
+                    {
+                        pointer.scale
+                        (
+                            i,
+                            uint32_t(v[i]*(1 << PointerMotion::scaleShift_))
+                        );
+                    }
+                }
+                break;
+
+            case 'a':
+                {
+                    double v[PointerMotion::nAccelPoints_];
+                    if (!parseNumbers(optarg, v, PointerMotion::nAccelPoints_))
+                    {
+                        printUsage(cerr, 1);
+                    }
+                    for (uint8_t i=0; i<PointerMotion::nAccelPoints_; i++)
+                    {
+                        if (v[i] < 0 || v[i] > 255)
+                        {
+                            printUsage(cerr, 1);
+                        }
+                        pointer.accelCurve(i, uint8_t(v[i]));
+                    }
+                }
+                break;
+
+            case 'v':
+                verbose = true;
+                break;
+
+            case -1:    // Done with options.
+                break;
+
+            default:    // Something else: unexpected.
+                printUsage(cerr, 1);
+        }
+    } while (opt != -1);
+
+    if (!duration)
+    {
+        duration = sensorModels[0].scriptDuration() + 1000;
+    }
+
+    // Time by which the sensors must be ready [ns]
+    const uint64_t wakeTimeout = 1000000000ULL;
+
+    ADNS9800 sensors[2] =
+    {
+        ADNS9800(),
+        ADNS9800(scrollBallNcs, scrollBallMot)
+    };
+
+    Simulator::addSensor(sensorModels[0], SS, 9);
+
+    if (nSensors > 1)
+    {
+        Simulator::addSensor(sensorModels[1], scrollBallNcs, scrollBallMot);
+    }
+
+    int64_t received[2][2] = {{0, 0}, {0, 0}};
+    uint32_t reads[2] = {0, 0};
+    uint64_t readyTime[2] = {0, 0};
+
+    // Pointer motion sent and the sum of the scaled motion before rounding
+    // in units of 2^-(scaleShift_ + accelShift_)
+    const uint8_t pointerShift =
+        PointerMotion::scaleShift_ + PointerMotion::accelShift_;
+    int64_t pointerSent[2] = {0, 0};
+    int64_t pointerScaled[2] = {0, 0};
+    uint32_t burstTime = 0;
+
+    for (uint8_t s=0; s<nSensors; s++)
+    {
+        sensorModels[s].verbose(verbose);
+        sensors[s].begin();
+    }
+
+    // The motion script starts when all the sensors are ready
+    uint64_t end = wakeTimeout;
+    uint8_t nReady = 0;
+
+    while (Simulator::now() < end)
+    {
+        for (uint8_t s=0; s<nSensors; s++)
+        {
+            if (sensors[s].wakeStep())
+            {
+                readyTime[s] = Simulator::now();
+
+                if (profile >= 0)
+                {
+                    sensors[s].setProfile(ADNS9800::profile(profile));
+                }
+
+                if (++nReady == nSensors)
+                {
+                    for (uint8_t m=0; m<nSensors; m++)
+                    {
+                        sensorModels[m].startScript(Simulator::now());
+                    }
+
+                    end = Simulator::now() + duration*1000000ULL;
+                }
+            }
+
+            sensors[s].adnsBurstMotionStart();
+        }
+
+        for (uint8_t s=0; s<nSensors; s++)
+        {
+            ADNS9800::burstData data;
+
+            if (sensors[s].adnsBurstMotion(data))
+            {
+                received[s][0] += data.dx;
+                received[s][1] += data.dy;
+                reads[s]++;
+
+                // Replay the trackball motion as TrackBall::moveOrScroll
+                if (s == 0 && !(data.motion & MOTION_LIFT))
+                {
+                    const uint32_t t = micros();
+                    const uint32_t interval = t - burstTime;
+                    burstTime = t;
+
+                    int16_t xy[2] = {data.dx, data.dy};
+                    const int32_t gain = pointer.accelGain(xy, interval);
+
+                    for (uint8_t i=0; i<2; i++)
+                    {
+                        pointerScaled[i] +=
+                            int64_t(xy[i])*pointer.scale(1 - i)*gain;
+                    }
+
+                    pointer.transfer(xy, interval);
+                    pointerSent[0] += xy[0];
+                    pointerSent[1] += xy[1];
+                }
+            }
+        }
+
+        delayMicroseconds(period);
+    }
+
+    const double seconds = double(Simulator::now())/1e9;
+    bool failed = nReady < nSensors || Simulator::conflicts() > 0;
+
+    for (uint8_t s=0; s<nSensors; s++)
+    {
+        const ADNS9800Model& model = sensorModels[s];
+
+        printf("Sensor %d\n", s);
+        printf
+        (
+            "    SROM verified        %s\n",
+            model.sromValid() ? "yes" : "no"
+        );
+        printf("    ready after          %.3fms\n", double(readyTime[s])/1e6);
+        printf
+        (
+            "    motion bursts        %u (%.1f/s), %u read\n",
+            model.bursts(),
+            model.bursts()/seconds,
+            reads[s]
+        );
+        printf
+        (
+            "    motion generated     %lld %lld\n",
+            (long long)model.generated(0),
+            (long long)model.generated(1)
+        );
+        printf
+        (
+            "    motion received      %lld %lld\n",
+            (long long)received[s][0],
+            (long long)received[s][1]
+        );
+        printf
+        (
+            "    motion-to-read       %.1fus mean, %.1fus max\n",
+            double(model.latencyMean())/1e3,
+            double(model.latencyMax())/1e3
+        );
+
+        bool violations = false;
+
+        for (uint8_t v=0; v<ADNS9800Model::nViolations; v++)
+        {
+            const ADNS9800Model::violation vi = ADNS9800Model::violation(v);
+
+            if (model.violations(vi))
+            {
+                printf
+                (
+                    "    violations %-11s %u\n",
+                    ADNS9800Model::violationNames_[v],
+                    model.violations(vi)
+                );
+                violations = true;
+            }
+        }
+
+        if (!violations)
+        {
+            printf("    violations           none\n");
+        }
+
+        failed =
+            failed
+         || violations
+         || !model.sromValid()
+         || received[s][0] != model.generated(0)
+         || received[s][1] != model.generated(1);
+    }
+
+    // The pointer motion sent is the scaled motion rounded down, any
+    // difference is drift accumulated by the transfer
+    const int64_t drift[2] =
+    {
+        pointerSent[0] - (pointerScaled[0] >> pointerShift),
+        pointerSent[1] - (pointerScaled[1] >> pointerShift)
+    };
+
+    printf
+    (
+        "Pointer sent %lld %lld, drift %lld %lld\n",
+        (long long)pointerSent[0],
+        (long long)pointerSent[1],
+        (long long)drift[0],
+        (long long)drift[1]
+    );
+
+    failed = failed || drift[0] || drift[1];
+
+    printf
+    (
+        "SPI bus busy %.2f%%, conflicts %u\n",
+        100*double(Simulator::busBusy())/Simulator::now(),
+        Simulator::conflicts()
+    );
+
+    return failed;
+}
+
+
+// -----------------------------------------------------------------------------
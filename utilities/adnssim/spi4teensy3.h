@@ -0,0 +1,33 @@
+/*
+ * File:   spi4teensy3.h
+ *
+ * Host replacement for libraries/spi4teensy3 used by the ADNS-9800
+ * simulator.  Bytes are clocked on the simulated clock at the SPI clock
+ * the driver sets from a 48MHz bus clock and exchanged with the sensor
+ * model selected by its NCS pin; DMA transfers proceed in simulated time
+ * and call back as from the interrupt on completion.
+ */
+
+#ifndef SPI4TEENSY3_H
+#define	SPI4TEENSY3_H
+
+#include "WProgram.h"
+
+namespace spi4teensy3 {
+        void init();
+        void init(uint8_t speed);
+        void init(uint8_t cpol, uint8_t cpha);
+        void init(uint8_t speed, uint8_t cpol, uint8_t cpha);
+        uint8_t speed(uint32_t hz);
+        uint32_t sclk(uint8_t speed);
+        void send(uint8_t b);
+        void send(void *bufr, size_t n);
+        uint8_t receive();
+        void receive(void *bufr, size_t n);
+        void dmaSend(const void *bufr, size_t n, void (*callback)(), uint16_t interval = 0);
+        void dmaReceive(void *bufr, size_t n, void (*callback)(), uint16_t interval = 0, uint16_t delay = 0);
+        bool dmaBusy();
+        void dmaWait();
+};
+
+#endif	/* SPI4TEENSY3_H */
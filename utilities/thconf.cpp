@@ -22,13 +22,17 @@
 ///  Description:
 //    Updates the configuration of the TrackHand via the USB serial device.
 //    Movement resolution, scroll speed, idle timeout, and keymaps may be
-//    reconfigured.
+//    reconfigured.  Each request is sent as a frame of the configuration
+//    protocol, see TrackHand/ConfigFrame.h, and its reply checked.
 // -----------------------------------------------------------------------------
 
 #include <iostream>
+#include <fstream>
+#include <sstream>
 #include <cerrno>
 #include <cstring>
 #include <cstdlib>
+#include <algorithm>
 #include <stdint.h>
 
 #include <unistd.h>  // UNIX standard function definitions
@@ -36,6 +40,9 @@
 #include <termios.h> // POSIX terminal control definitions
 #include <getopt.h>
 
+#include "../TrackHand/CRC16.h"
+#include "../TrackHand/ConfigFrame.h"
+
 using std::cout;
 using std::cerr;
 using std::endl;
@@ -115,58 +122,201 @@ int port(const char* ttyName)
 }
 
 
-void print(const int fd)
+// Read n bytes from the serial port waiting up to timeout ms
+bool readBytes(const int fd, uint8_t* buf, const size_t n, const int timeout)
 {
-    // Need large delay between send and receive
-    usleep(50000);
+    size_t nRead = 0;
 
-    while(1)
+    for (int t=0; nRead < n && t < timeout; t++)
     {
-        char c;
-        int n = read(fd, &c, 1);
+        int nr = read(fd, buf + nRead, n - nRead);
 
-        if (n == -1)
+        if (nr > 0)
         {
-            return;
+            nRead += nr;
         }
         else
+        {
+            usleep(1000);
+        }
+    }
+
+    return nRead == n;
+}
+
+
+// Send the frame of the type with the n bytes of payload
+void sendFrame
+(
+    const int fd,
+    const uint8_t type,
+    const void* payload,
+    const uint16_t n
+)
+{
+    uint8_t buf
+    [
+        ConfigFrame::headerSize + ConfigFrame::maxPayload + ConfigFrame::crcSize
+    ];
+
+    buf[0] = ConfigFrame::start;
+    buf[1] = type;
+    buf[2] = n & 0xff;
+    buf[3] = n >> 8;
+    if (n)
+    {
+        std::memcpy(buf + ConfigFrame::headerSize, payload, n);
+    }
+
+    const uint16_t crc = crc16(buf + 1, ConfigFrame::headerSize - 1 + n);
+    buf[ConfigFrame::headerSize + n] = crc & 0xff;
+    buf[ConfigFrame::headerSize + n + 1] = crc >> 8;
+
+    const size_t nb = ConfigFrame::headerSize + n + ConfigFrame::crcSize;
+
+    if (write(fd, buf, nb) != int(nb))
+    {
+        cerr<< "thconf::sendFrame: sending frame " << int(type)
+            << " failed" << endl;
+        std::exit(1);
+    }
+}
+
+
+// Read the reply to the frame of the type, printing any text preceding it,
+// returning the result and up to maxN bytes of data following it in data
+// and their number in n
+uint8_t readReply
+(
+    const int fd,
+    const uint8_t type,
+    uint8_t* data = NULL,
+    const uint16_t maxN = 0,
+    uint16_t* n = NULL
+)
+{
+    uint8_t c = 0;
+
+    while (c != ConfigFrame::start)
+    {
+        if (!readBytes(fd, &c, 1, 2000))
+        {
+            cerr<< "thconf::readReply: reply not received" << endl;
+            std::exit(1);
+        }
+
+        if (c != ConfigFrame::start)
         {
             cout<< c;
         }
     }
+
+    uint8_t buf
+    [
+        ConfigFrame::headerSize + ConfigFrame::maxPayload + ConfigFrame::crcSize
+    ];
+    buf[0] = c;
+
+    if (!readBytes(fd, buf + 1, ConfigFrame::headerSize - 1, 2000))
+    {
+        cerr<< "thconf::readReply: reply incomplete" << endl;
+        std::exit(1);
+    }
+
+    const uint16_t len = buf[2] | (buf[3] << 8);
+
+    if
+    (
+        len < 1
+     || len > ConfigFrame::maxPayload
+     || !readBytes
+        (
+            fd,
+            buf + ConfigFrame::headerSize,
+            len + ConfigFrame::crcSize,
+            2000
+        )
+    )
+    {
+        cerr<< "thconf::readReply: reply incomplete" << endl;
+        std::exit(1);
+    }
+
+    const uint8_t* crc = buf + ConfigFrame::headerSize + len;
+
+    if
+    (
+        crc16(buf + 1, ConfigFrame::headerSize - 1 + len)
+     != (crc[0] | (crc[1] << 8))
+     || buf[1] != (type | ConfigFrame::reply)
+    )
+    {
+        cerr<< "thconf::readReply: reply corrupt" << endl;
+        std::exit(1);
+    }
+
+    if (n)
+    {
+        *n = std::min(uint16_t(len - 1), maxN);
+        std::memcpy(data, buf + ConfigFrame::headerSize + 1, *n);
+    }
+
+    return buf[ConfigFrame::headerSize];
 }
 
 
-void sendCommand(const int fd, const char cmd, const char* message)
+// Report the result of a request
+void checkResult(const uint8_t result, const char* request)
 {
-    int n = write(fd, &cmd, 1);
+    static const char* resultNames[] =
+    {
+        "ok", "CRC error", "unknown frame type", "invalid arguments",
+        "unknown command", "failed"
+    };
 
-    if (n < 0)
+    if (result != ConfigFrame::ok)
     {
-        cerr<< "thconf::sendCommand: sending command '" << cmd
-            << "' failed" << endl;
+        cerr<< "thconf: " << request << ' '
+            << (result < 6 ? resultNames[result] : "failed") << endl;
     }
-    else
+}
+
+
+// Send the command with the n bytes of its value
+void sendCommandFrame
+(
+    const int fd,
+    const char cmd,
+    const void* value = NULL,
+    const size_t n = 0
+)
+{
+    uint8_t payload[1 + 8];
+    payload[0] = cmd;
+
+    if (n)
     {
-        cout<< message << endl;
+        std::memcpy(payload + 1, value, n);
     }
+    sendFrame(fd, ConfigFrame::command, payload, 1 + n);
 }
 
 
-template<typename Type>
-void setValue(const int fd, const char cmd, const Type val)
+void sendCommand(const int fd, const char cmd, const char* message)
 {
-    const uint8_t nb = 1 + 2*sizeof(Type);
-    char buf[nb];
-    Type check = cmd ^ val;
+    sendCommandFrame(fd, cmd);
+    cout<< message << endl;
 
-    buf[0] = cmd;
-    std::memcpy(buf+1, (void *)(&val), sizeof(Type));
-    std::memcpy(buf+1+sizeof(Type), (void *)(&check), sizeof(Type));
+    checkResult(readReply(fd, ConfigFrame::command), "command");
+}
 
-    int n = write(fd, buf, nb);
 
-    if (n < 0)
+template<typename Type>
+void setValue(const int fd, const char cmd, const Type val)
+{
+    sendCommandFrame(fd, cmd, &val, sizeof(Type));
+
+    if (readReply(fd, ConfigFrame::command) != ConfigFrame::ok)
     {
         cerr<< "thconf::setValue: setting " << val << " failed" << endl;
     }
@@ -177,6 +327,235 @@ void setValue(const int fd, const char cmd, const Type val)
 }
 
 
+// Request n pixel frames from the TrackBall sensor
+// and write them to the PGM files capture-<i>.pgm
+void captureFrames(const int fd, const uint8_t n)
+{
+    sendCommandFrame(fd, 'c', &n, 1);
+
+    for (int i=0; i<n; i++)
+    {
+        // Frame header: 'P' 'X' width height
+        uint8_t header[4];
+
+        if
+        (
+            !readBytes(fd, header, 4, 2000)
+         || header[0] != 'P'
+         || header[1] != 'X'
+        )
+        {
+            cerr<< "thconf::captureFrames: frame " << i
+                << " not received" << endl;
+            return;
+        }
+
+        const size_t nPixels = header[2]*header[3];
+        uint8_t pixels[256*256];
+
+        if (!readBytes(fd, pixels, nPixels, 2000))
+        {
+            cerr<< "thconf::captureFrames: frame " << i
+                << " incomplete" << endl;
+            return;
+        }
+
+        std::ostringstream fileName;
+        fileName << "capture-" << i << ".pgm";
+        std::ofstream pgm(fileName.str().c_str(), std::ios::binary);
+        pgm << "P5\n" << int(header[2]) << ' ' << int(header[3]) << "\n255\n";
+        pgm.write((const char*)pixels, nPixels);
+
+        cout<< "Written " << fileName.str() << endl;
+    }
+
+    checkResult(readReply(fd, ConfigFrame::command), "capture");
+}
+
+
+// Print the state of the configuration store
+void printStatus(const int fd)
+{
+    sendFrame(fd, ConfigFrame::status, NULL, 0);
+
+    ConfigFrame::storeStatus s;
+    uint16_t n;
+    const uint8_t result = readReply
+    (
+        fd,
+        ConfigFrame::status,
+        (uint8_t*)&s,
+        sizeof(s),
+        &n
+    );
+
+    if (result != ConfigFrame::ok || n != sizeof(s))
+    {
+        // A short reply is reported as failed
+        checkResult
+        (
+            result == ConfigFrame::ok ? uint8_t(ConfigFrame::failed) : result,
+            "status"
+        );
+        return;
+    }
+
+    static const char* storedNames[] =
+    {
+        "blank", "corrupt", "other-version", "valid"
+    };
+
+    cout<< "stored " << (s.stored < 4 ? storedNames[s.stored] : "unknown") << endl
+        << "migrated " << int(s.migrated) << endl
+        << "version " << int(s.version) << endl
+        << "profiles " << int(s.nProfiles) << endl
+        << "profile " << int(s.profile) << endl
+        << "pending " << int(s.pending) << endl
+        << "length " << s.length << endl
+        << "writes " << s.writes << endl
+        << "commits " << s.commits << endl
+        << "bytesWritten " << s.bytesWritten << endl;
+}
+
+
+// Return the layout reply and the size of each profile
+uint16_t readLayout(const int fd, uint8_t* layout, uint16_t& n)
+{
+    sendFrame(fd, ConfigFrame::layout, NULL, 0);
+    checkResult
+    (
+        readReply(fd, ConfigFrame::layout, layout, ConfigFrame::maxPayload, &n),
+        "layout"
+    );
+
+    uint16_t size = 0;
+
+    for (uint8_t i=0; i<layout[3] && 4 + 2*i + 1 < n; i++)
+    {
+        size += layout[4 + 2*i] | (layout[4 + 2*i + 1] << 8);
+    }
+
+    return size;
+}
+
+
+// Largest block of a profile read or written per frame
+static const uint16_t chunk = ConfigFrame::maxPayload - 4;
+
+
+// Write the layout and all the profiles to the file
+void backup(const int fd, const char* fileName)
+{
+    uint8_t layout[ConfigFrame::maxPayload];
+    uint16_t nLayout;
+    const uint16_t size = readLayout(fd, layout, nLayout);
+    const uint8_t nProfiles = layout[1];
+
+    std::ofstream file(fileName, std::ios::binary);
+    file.write((const char*)&nLayout, sizeof(nLayout));
+    file.write((const char*)layout, nLayout);
+
+    for (uint8_t p=0; p<nProfiles; p++)
+    {
+        for (uint16_t offset=0; offset<size; offset+=chunk)
+        {
+            const uint16_t nGet = std::min(chunk, uint16_t(size - offset));
+            const uint8_t request[5] =
+            {
+                p,
+                uint8_t(offset), uint8_t(offset >> 8),
+                uint8_t(nGet), uint8_t(nGet >> 8)
+            };
+            sendFrame(fd, ConfigFrame::get, request, sizeof(request));
+
+            uint8_t data[ConfigFrame::maxPayload];
+            uint16_t n;
+            const uint8_t result = readReply
+            (
+                fd,
+                ConfigFrame::get,
+                data,
+                sizeof(data),
+                &n
+            );
+
+            if (result != ConfigFrame::ok || n != nGet)
+            {
+                checkResult(result, "get");
+                return;
+            }
+
+            file.write((const char*)data, n);
+        }
+    }
+
+    cout<< "Written " << int(nProfiles) << " profiles to " << fileName << endl;
+}
+
+
+// Set all the profiles from the file written by backup
+// if the layout is unchanged
+void restore(const int fd, const char* fileName)
+{
+    std::ifstream file(fileName, std::ios::binary);
+
+    uint16_t nFileLayout = 0;
+    uint8_t fileLayout[ConfigFrame::maxPayload];
+    file.read((char*)&nFileLayout, sizeof(nFileLayout));
+
+    if (!file || nFileLayout > sizeof(fileLayout))
+    {
+        cerr<< "thconf::restore: cannot read " << fileName << endl;
+        return;
+    }
+
+    file.read((char*)fileLayout, nFileLayout);
+
+    uint8_t layout[ConfigFrame::maxPayload];
+    uint16_t nLayout;
+    const uint16_t size = readLayout(fd, layout, nLayout);
+
+    // The profile selected need not match
+    fileLayout[2] = layout[2];
+
+    if
+    (
+        nLayout != nFileLayout
+     || std::memcmp(layout, fileLayout, nLayout) != 0
+    )
+    {
+        cerr<< "thconf::restore: layout of " << fileName
+            << " differs from that of the TrackHand" << endl;
+        return;
+    }
+
+    for (uint8_t p=0; p<layout[1]; p++)
+    {
+        for (uint16_t offset=0; offset<size; offset+=chunk)
+        {
+            const uint16_t nSet = std::min(chunk, uint16_t(size - offset));
+
+            uint8_t request[3 + ConfigFrame::maxPayload];
+            request[0] = p;
+            request[1] = uint8_t(offset);
+            request[2] = uint8_t(offset >> 8);
+            file.read((char*)request + 3, nSet);
+
+            if (!file)
+            {
+                cerr<< "thconf::restore: " << fileName << " incomplete" << endl;
+                return;
+            }
+
+            sendFrame(fd, ConfigFrame::set, request, 3 + nSet);
+            checkResult(readReply(fd, ConfigFrame::set), "set");
+        }
+    }
+
+    cout<< "Restored " << int(layout[1]) << " profiles from " << fileName << endl;
+}
+
+
 void printUsage(std::ostream& os, int exitCode)
 {
     os << "Usage: thconf [OPTION]..." << endl;
@@ -186,8 +565,33 @@ void printUsage(std::ostream& os, int exitCode)
         "  -p  --print              Request that the TrackHand prints the current configuration.\n"
         "  -r  --resolution <val>   Set the pointer motion resolution in increments of 50cpi in range 1-168.\n"
         "  -s  --scroll <val>       Set the scroll divider to reduce the scroll speed.\n"
-        "  -t  --timeout <val>      Time of inactivity after which power saving is enabled.\n"
+        "  -t  --timeout <val>      Time of inactivity (s) after which power saving is enabled.\n"
+        "  -i  --idle <val>         Time of inactivity (s) after which the idle trackball sensor profile is selected.\n"
+        "  -S  --scan-timeout <val> Time of inactivity (s) after which the keys are scanned slowly.\n"
+        "  -L  --led-timeout <val>  Time of inactivity (s) after which the mode LED is switched off.\n"
+        "  -C  --clock-timeout <val>\n"
+        "                           Time of inactivity (s) after which the CPU clock is reduced if the USB bus is suspended.\n"
+        "  -H  --hibernate-timeout <val>\n"
+        "                           Time of inactivity (s) after which deep sleep is changed to hibernation.\n"
+        "  -f  --profile <n>        Select the trackball sensor profile in use:\n"
+        "                           0: maxPerformance, 1: balanced, 2: battery.\n"
+        "  -F  --idle-profile <n>   Select the trackball sensor profile when idle.\n"
+        "  -x  --scalex <val>       Set the scale of the pointer x motion, e.g. 1.5.\n"
+        "  -y  --scaley <val>       Set the scale of the pointer y motion.\n"
+        "  -a  --accel <g0,...,g7>  Set the pointer acceleration curve gains in units of 1/16\n"
+        "                           at speeds of 1, 2, 4 ... 128 counts per millisecond.\n"
+        "  -c  --capture <n>        Capture n trackball sensor pixel frames to capture-<i>.pgm.\n"
+        "  -u  --usb                Request that the TrackHand prints the USB packet statistics.\n"
+        "  -q  --quality            Request that the TrackHand prints the trackball sensor statistics.\n"
+        "  -e  --energy             Request that the TrackHand prints the power-state residency and energy statistics.\n"
+        "  -I  --current <mA>,...   Set the current drawn in each power state in mA:\n"
+        "                           active, slowScan, sensorRest, ledOff, reducedClock, deepSleep.\n"
         "  -k  --keymap <file>      Load a keymap from file.\n"
+        "  -P  --config-profile <n> Select the configuration profile 0-3 to which the settings apply.\n"
+        "  -Q  --status             Print the state of the configuration store.\n"
+        "  -b  --backup <file>      Write all the configuration profiles to file.\n"
+        "  -B  --restore <file>     Set all the configuration profiles from file.\n"
+        "  -R  --reset              Restore the default configuration and restart the TrackHand.\n"
     ;
 
     std::exit(exitCode);
@@ -200,7 +604,7 @@ int main(int argc, char * const *argv)
     const char *programName = argv[0];
 
     // A string listing valid short options letters.
-    const char* const shortOptions = "hd:pr:s:t:k:";
+    const char* const shortOptions = "hd:pr:s:t:i:S:L:C:H:f:F:x:y:a:c:uqeI:k:P:Qb:B:R";
 
     // An array describing valid long options.
     const struct option longOptions[] =
@@ -211,7 +615,27 @@ int main(int argc, char * const *argv)
         { "resolution",   1, NULL, 'r' },
         { "scroll",       1, NULL, 's' },
         { "timeout",      1, NULL, 't' },
+        { "idle",         1, NULL, 'i' },
+        { "scan-timeout", 1, NULL, 'S' },
+        { "led-timeout",  1, NULL, 'L' },
+        { "clock-timeout",     1, NULL, 'C' },
+        { "hibernate-timeout", 1, NULL, 'H' },
+        { "profile",      1, NULL, 'f' },
+        { "idle-profile", 1, NULL, 'F' },
+        { "scalex",       1, NULL, 'x' },
+        { "scaley",       1, NULL, 'y' },
+        { "accel",        1, NULL, 'a' },
+        { "capture",      1, NULL, 'c' },
+        { "usb",          0, NULL, 'u' },
+        { "quality",      0, NULL, 'q' },
+        { "energy",       0, NULL, 'e' },
+        { "current",      1, NULL, 'I' },
         { "keymap",       1, NULL, 'k' },
+        { "config-profile", 1, NULL, 'P' },
+        { "status",       0, NULL, 'Q' },
+        { "backup",       1, NULL, 'b' },
+        { "restore",      1, NULL, 'B' },
+        { "reset",        0, NULL, 'R' },
         { NULL,           0, NULL, 0   }   // Required at end of array.
     };
 
@@ -246,7 +670,6 @@ int main(int argc, char * const *argv)
 
             case 'p':   // -p or --print
                 sendCommand(port(ttyName), opt, "Current configuration:");
-                print(port(ttyName));
                 break;
 
             case 'r':   // -r <val> or --resolution <val>
@@ -261,10 +684,97 @@ int main(int argc, char * const *argv)
                 setValue(port(ttyName), opt, uint16_t(atoi(optarg)));
                 break;
 
+            case 'i':   // -i <val> or --idle <val>
+            case 'S':   // -S <val> or --scan-timeout <val>
+            case 'L':   // -L <val> or --led-timeout <val>
+            case 'C':   // -C <val> or --clock-timeout <val>
+            case 'H':   // -H <val> or --hibernate-timeout <val>
+                setValue(port(ttyName), opt, uint16_t(atoi(optarg)));
+                break;
+
+            case 'f':   // -f <n> or --profile <n>
+            case 'F':   // -F <n> or --idle-profile <n>
+                setValue(port(ttyName), opt, uint8_t(atoi(optarg)));
+                break;
+
+            case 'x':   // -x <val> or --scalex <val>
+            case 'y':   // -y <val> or --scaley <val>
+                // Send the scale in units of 2^-16
+                setValue(port(ttyName), opt, uint32_t(atof(optarg)*65536 + 0.5));
+                break;
+
+            case 'a':   // -a <gains> or --accel <gains>
+            {
+                // Send each gain of the comma-separated list
+                // as (index << 8) | gain
+                const char* gains = optarg;
+                for (uint16_t i=0; i<8 && *gains; i++)
+                {
+                    char* end;
+                    const uint16_t gain = std::strtol(gains, &end, 10);
+                    if (end == gains) break;
+                    setValue(port(ttyName), opt, uint16_t((i << 8) | (gain & 0xff)));
+                    gains = *end == ',' ? end + 1 : end;
+                }
+                break;
+            }
+
+            case 'c':   // -c <n> or --capture <n>
+                captureFrames(port(ttyName), uint8_t(atoi(optarg)));
+                break;
+
+            case 'u':   // -u or --usb
+                sendCommand(port(ttyName), opt, "USB statistics:");
+                break;
+
+            case 'q':   // -q or --quality
+                sendCommand(port(ttyName), opt, "TrackBall sensor statistics:");
+                break;
+
+            case 'e':   // -e or --energy
+                sendCommand(port(ttyName), opt, "Power statistics:");
+                break;
+
+            case 'I':   // -I <mA>,... or --current <mA>,...
+            {
+                // Send the current of each state of the comma-separated list
+                // in units of 10uA as (index << 16) | current
+                const char* currents = optarg;
+                for (uint32_t i=0; i<6 && *currents; i++)
+                {
+                    char* end;
+                    const uint32_t current = std::strtod(currents, &end)*100 + 0.5;
+                    if (end == currents) break;
+                    setValue(port(ttyName), opt, uint32_t((i << 16) | (current & 0xffff)));
+                    currents = *end == ',' ? end + 1 : end;
+                }
+                break;
+            }
+
             case 'k':   // -k <file> or --keymap <file>
                 // Not implemented yet
                 break;
 
+            case 'P':   // -P <n> or --config-profile <n>
+                setValue(port(ttyName), opt, uint8_t(atoi(optarg)));
+                break;
+
+            case 'Q':   // -Q or --status
+                printStatus(port(ttyName));
+                break;
+
+            case 'b':   // -b <file> or --backup <file>
+                backup(port(ttyName), optarg);
+                break;
+
+            case 'B':   // -B <file> or --restore <file>
+                restore(port(ttyName), optarg);
+                break;
+
+            case 'R':   // -R or --reset
+                sendCommand(port(ttyName), opt, "Restoring the default configuration:");
+                break;
+
             case '?':   // The user specified an invalid option.
                 // Print usage information to standard error, and exit with exit
                 // code one (indicating abnormal termination).